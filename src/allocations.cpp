@@ -0,0 +1,169 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+// Checks that the 1D engines, and compiled expressions, do not allocate once warmed up.
+// The global operator new is replaced by one which counts, each engine runs twice,
+// and the second run must not allocate. Exits with 1 if one does,
+// or if an integrand returning int is not summed in Real.
+//
+// The multi-dimensional and parallel engines are not covered, see README.md.
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <concepts>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <span>
+
+#include "./quadrature.hpp"
+#include "./expression.hpp"
+#include "./global.hpp"
+#include "./reverse.hpp"
+
+namespace
+{
+	std::atomic<std::size_t> allocations{ 0 };
+
+	void* Allocate(
+		std::size_t const size,
+		std::size_t const alignment = alignof(std::max_align_t))
+	{
+		++allocations;
+		std::size_t const bytes = (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment;
+		if (void* const memory = std::aligned_alloc(alignment, bytes))
+			return memory;
+		throw std::bad_alloc();
+	};
+};
+
+void* operator new(std::size_t const size)
+{
+	return Allocate(size);
+};
+
+void* operator new(
+	std::size_t const size,
+	std::align_val_t const alignment)
+{
+	return Allocate(size, static_cast<std::size_t>(alignment));
+};
+
+void operator delete(void* const memory) noexcept
+{
+	std::free(memory);
+};
+
+void operator delete(
+	void* const memory,
+	std::size_t) noexcept
+{
+	std::free(memory);
+};
+
+void operator delete(
+	void* const memory,
+	std::align_val_t) noexcept
+{
+	std::free(memory);
+};
+
+void operator delete(
+	void* const memory,
+	std::size_t,
+	std::align_val_t) noexcept
+{
+	std::free(memory);
+};
+
+int main()
+{
+	bool failed{ false };
+
+	// Allocations of the second of two runs
+	auto check = [&failed](char const* name, auto const& run)
+	{
+		run();
+		std::size_t const before = allocations;
+		run();
+		std::size_t const count = allocations - before;
+		std::cout << name << count << "\n";
+		failed |= count > 0;
+	};
+
+	// Larger than the small buffer of std::function
+	std::array<Real, 8> const coefficients{ 1, 2, 3, 4, 5, 6, 7, 8 };
+	auto polynomial = [coefficients](Real const& x) -> Real
+	{
+		Real y{ 0 };
+		for (Real const& c : coefficients)
+			y = y * x + c;
+		return y;
+	};
+	auto complex = [](Real const& x) -> std::complex<Real>
+	{
+		return std::exp(std::complex<Real>(0, x));
+	};
+	auto batch = [](std::span<Real const> x, std::span<Real> y)
+	{
+		for (std::size_t i{ 0 };i < x.size();++i)
+			y[i] = std::sqrt(x[i]);
+	};
+
+	Real volatile sink{ 0 };
+	check("Simpson:          ", [&]() { sink = Quadrature::Simpson(polynomial, 0, 1, 1e-14, 16); });
+	check("Lobatto:          ", [&]() { sink = Quadrature::LobattoResult(polynomial, 0, 1, 1e-14, 8).value; });
+	check("Lobatto, complex: ", [&]() { sink = Quadrature::Lobatto(complex, 0, pi).imag(); });
+	check("Lobatto, global:  ", [&]() { sink = Quadrature::LobattoGlobal(polynomial, 0, 1, 1e-14).value; });
+	check("Lobatto, nested:  ", [&]()
+		{
+			auto outer = [&polynomial](Real const& y) -> Real
+			{
+				return y * Quadrature::LobattoGlobal(polynomial, 0, y, 1e-12).value;
+			};
+			sink = Quadrature::LobattoGlobal(outer, 0, 1, 1e-12).value;
+		});
+	check("Lobatto, batch:   ", [&]() { sink = Quadrature::LobattoBatch(batch, 0, 1, 1e-14, 8).value; });
+
+	Quadrature::Expression const expression("sqrt(x)+1/(3*sqrt(x))");
+	Quadrature::Expression const other("sin(x)^2");
+	check("Expression:       ", [&]()
+		{
+			sink = Quadrature::LobattoResult(expression, 1, 2, 1e-14, 8).value;
+			sink = Quadrature::LobattoBatch(expression, 1, 2, 1e-14, 8).value;
+			sink = other(1) + expression(1);
+		});
+	check("RealToChars:      ", [&]()
+		{
+			std::array<char, 64> text;
+			sink = RealToChars(text.data(), text.data() + text.size(), pi).ptr - text.data();
+		});
+
+	// Integrands returning any arithmetic type are summed in Real
+	auto integer = [](Real const&) { return 1; };
+	auto narrow = [](Real const& x) { return static_cast<double>(x); };
+	static_assert(std::same_as<decltype(Quadrature::Simpson(integer, 0, 1)), Real>);
+	static_assert(std::same_as<decltype(Quadrature::Lobatto(narrow, 0, 1)), Real>);
+	static_assert(std::same_as<decltype(Quadrature::LobattoGlobal(narrow, 0, 1).value), Real>);
+	bool const summed = std::abs(Quadrature::Lobatto(integer, 0, 0.5) - Real(0.5)) < 8 * numeric_epsilon;
+	std::cout << "Integer integrand: " << (summed ? "summed in Real" : "truncated") << "\n";
+
+	std::cout << (failed ? "Allocations after warm-up\n" : "No allocations after warm-up\n");
+	return failed || !summed ? 1 : 0;
+};
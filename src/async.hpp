@@ -0,0 +1,266 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./reverse.hpp"
+
+// Asynchronous integration, for integrands with latency (I/O, a model server),
+// the integrand returns an awaitable and many evaluations are kept in flight
+namespace Quadrature
+{
+	// Lazily started coroutine with a value,
+	// resumes its awaiting coroutine when done
+	template <typename T>
+	class Task
+	{
+	public:
+		struct promise_type;
+		using Handle = std::coroutine_handle<promise_type>;
+
+		struct promise_type
+		{
+			T value{};
+			std::coroutine_handle<> continuation{ std::noop_coroutine() };
+
+			Task get_return_object()
+			{
+				return Task(Handle::from_promise(*this));
+			};
+
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			};
+
+			struct Final
+			{
+				bool await_ready() noexcept { return false; };
+				std::coroutine_handle<> await_suspend(Handle handle) noexcept { return handle.promise().continuation; };
+				void await_resume() noexcept {};
+			};
+
+			Final final_suspend() noexcept
+			{
+				return {};
+			};
+
+			void return_value(T result)
+			{
+				value = std::move(result);
+			};
+
+			// No exceptions, as the engines
+			void unhandled_exception()
+			{
+				std::terminate();
+			};
+		};
+
+		Task(Task&& other) noexcept
+			: coroutine(std::exchange(other.coroutine, {})) {
+		};
+
+		~Task()
+		{
+			if (coroutine)
+				coroutine.destroy();
+		};
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		};
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			coroutine.promise().continuation = awaiting;
+			return coroutine;
+		};
+
+		T await_resume()
+		{
+			return std::move(coroutine.promise().value);
+		};
+
+	private:
+		explicit Task(Handle handle)
+			: coroutine(handle) {
+		};
+
+		Handle coroutine;
+	};
+
+	namespace Detail
+	{
+		// Coroutine nobody awaits, its frame is freed when it finishes
+		struct Detached
+		{
+			struct promise_type
+			{
+				Detached get_return_object() { return {}; };
+				std::suspend_never initial_suspend() noexcept { return {}; };
+				std::suspend_never final_suspend() noexcept { return {}; };
+				void return_void() {};
+				void unhandled_exception() { std::terminate(); };
+			};
+		};
+
+		template <typename Awaitable>
+		decltype(auto) Awaiter(Awaitable&& awaitable)
+		{
+			if constexpr (requires { std::forward<Awaitable>(awaitable).operator co_await(); })
+				return std::forward<Awaitable>(awaitable).operator co_await();
+			else if constexpr (requires { operator co_await(std::forward<Awaitable>(awaitable)); })
+				return operator co_await(std::forward<Awaitable>(awaitable));
+			else
+				return std::forward<Awaitable>(awaitable);
+		};
+
+		// Value an awaitable completes with
+		template <typename Awaitable>
+		using AwaitResult = std::decay_t<decltype(Awaiter(std::declval<Awaitable>()).await_resume())>;
+
+		// Evaluate f at all abscissae, at most 'window' at a time.
+		// Every worker takes the next abscissa when its evaluation completes,
+		// and the last one to complete resumes the awaiting coroutine.
+		template <typename Function, typename Value>
+		struct Gather
+		{
+			struct State
+			{
+				std::atomic<std::size_t> next{ 0 };
+				// Evaluations left, plus one held by await_suspend until all workers are started
+				std::atomic<std::size_t> remaining{ 0 };
+				std::coroutine_handle<> waiter;
+			};
+
+			Function const& function;
+			std::span<Real const> x;
+			std::span<Value> values;
+			std::size_t window;
+
+			// Shared, workers may still look at 'next' after the waiter moved on
+			static Detached Worker(
+				std::shared_ptr<State> state,
+				Function const& function,
+				std::span<Real const> x,
+				std::span<Value> values)
+			{
+				for (std::size_t i = state->next++;i < x.size();i = state->next++)
+				{
+					values[i] = co_await function(x[i]);
+					if (--state->remaining == 0)
+					{
+						state->waiter.resume();
+						co_return;
+					}
+				};
+			};
+
+			bool await_ready() const noexcept
+			{
+				return x.empty();
+			};
+
+			bool await_suspend(std::coroutine_handle<> awaiting)
+			{
+				auto state = std::make_shared<State>();
+				state->remaining = x.size() + 1;
+				state->waiter = awaiting;
+				for (std::size_t w{ 0 };w < std::min(std::max<std::size_t>(window, 1), x.size());++w)
+					Worker(state, function, x, values);
+				// All evaluations completed while starting, continue without suspending
+				return --state->remaining != 0;
+			};
+
+			void await_resume() noexcept {};
+		};
+	};
+
+	// Lobatto rule (as LobattoResult) with an integrand returning an awaitable,
+	// co_await function(x) gives f(x). All abscissae of a level, the five nodes of every
+	// interval and their siblings, are requested at once, at most 'window' in flight.
+	// Speculation requests the nodes of children before their parents are tested (see ReverseLobatto),
+	// hiding the latency of a level for at most 'budget' extra evaluations.
+	//
+	// Arguments are taken by value, as the task may start after the caller returns.
+	// Evaluations continue on the thread that completes the awaitable.
+	template <typename Function, typename Value = Accumulated<Detail::AwaitResult<std::invoke_result_t<Function const&, Real>>>>
+		requires std::invocable<Function const&, Real>
+	Task<Result<Value>> LobattoAsync(
+		Function function,
+		Real a,
+		Real b,
+		Real a_epsilon = 1e-10,
+		uint8_t a_max_depth = 2,
+		std::size_t window = 64,
+		uint8_t speculation = 0,
+		std::size_t budget = std::numeric_limits<std::size_t>::max())
+	{
+		ReverseLobatto<Value> machine(a, b, a_epsilon, a_max_depth, speculation, budget);
+		std::vector<Value> values;
+		while (!machine.Done())
+		{
+			std::span<Real const> x = machine.Request();
+			values.resize(x.size());
+			co_await Detail::Gather<Function, Value>{ function, x, values, window };
+			machine.Supply(values);
+		};
+		co_return machine.Outcome();
+	};
+
+	// Block until the task completes, for callers which are not coroutines
+	template <typename T>
+	T SyncWait(Task<T> task)
+	{
+		T result{};
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool done{ false };
+
+		auto run = [&]() -> Detail::Detached
+		{
+			T value = co_await std::move(task);
+			std::lock_guard lock(mutex);
+			result = std::move(value);
+			done = true;
+			condition.notify_one();
+		};
+		run();
+
+		std::unique_lock lock(mutex);
+		condition.wait(lock, [&done]() -> bool { return done; });
+		return result;
+	};
+
+};
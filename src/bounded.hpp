@@ -0,0 +1,313 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+#include "./quadrature.hpp"
+
+// Engines with memory, stack and work fixed at compile time, for real-time targets.
+// No recursion, no heap, no exceptions, and with QUADRATURE_FREESTANDING no streams.
+//
+// The depth is a template parameter, the panels waiting to be summed live in a
+// std::array of one frame per level, and the evaluations never exceed
+// LobattoEvaluations<MaxDepth>() or SimpsonEvaluations<MaxDepth>().
+//
+// Values, errors and evaluations are those of LobattoResult and Simpson,
+// the children of a panel are summed in the same order.
+// Unlike those, a non finite integrand ends the integral at once.
+namespace Quadrature::Bounded
+{
+	// Worst case integrand evaluations of Lobatto<MaxDepth>,
+	// 2 ends plus 5 per panel, for 6^0 + 6^1 + ... + 6^MaxDepth panels
+	template <uint8_t MaxDepth>
+	constexpr std::size_t LobattoEvaluations()
+	{
+		std::size_t panels{ 0 };
+		std::size_t level{ 1 };
+		for (uint8_t depth{ 0 };depth <= MaxDepth;++depth, level *= 6)
+			panels += level;
+		return 2 + 5 * panels;
+	};
+
+	// Worst case integrand evaluations of Simpson<MaxDepth>,
+	// 3 for the first panel plus 2 per panel, for 2^0 + 2^1 + ... + 2^MaxDepth panels
+	template <uint8_t MaxDepth>
+	constexpr std::size_t SimpsonEvaluations()
+	{
+		return 3 + 2 * ((std::size_t(2) << MaxDepth) - 1);
+	};
+
+	// LobattoResult with a_max_depth = MaxDepth
+	template <uint8_t MaxDepth, typename Function, typename Value = ValueOf<Function>>
+		requires std::invocable<Function const&, Real>
+	Result<Value> Lobatto(
+		Function const& function,
+		Real a,
+		Real b,
+		Real const& a_epsilon = 1e-10)
+	{
+		static_assert(MaxDepth <= 8, "As LobattoResult, at most 8 levels");
+
+		Real static const node_lobatto = std::sqrt(Real(1) / Real(5));
+		Real static const node_kronrod = std::sqrt(Real(2) / Real(3));
+
+		if (b < a)
+			std::swap(a, b);
+
+		Real const epsilon = std::max(a_epsilon, numeric_epsilon);
+
+		// Panel split into six, its children summed so far
+		struct Frame
+		{
+			std::array<Real, 7> x;
+			std::array<Value, 7> y;
+			Value sum;
+			uint8_t depth;
+			uint8_t next; // Child
+		};
+		// At least one, no frame is used at depth 0
+		std::array<Frame, std::max<std::size_t>(MaxDepth, 1)> frames;
+		std::size_t top{ 0 };
+
+		Result<Value> result;
+
+		// Area of an accepted panel in 'area', or a frame pushed, false if not finite
+		auto visit = [&](
+			Real const& start,
+			Real const& end,
+			Value const& y_start,
+			Value const& y_end,
+			uint8_t depth,
+			bool& accepted,
+			Value& area) -> bool
+		{
+			Real const h = (end - start) / 2;
+			Real const middle = (start + end) / 2;
+			std::array<Real, 7> const x{ start, middle - node_kronrod * h, middle - node_lobatto * h, middle,
+				middle + node_lobatto * h, middle + node_kronrod * h, end };
+
+			std::array<Value, 7> y;
+			y[0] = y_start;
+			for (std::size_t i{ 1 };i < 6;++i)
+				y[i] = function(x[i]);
+			y[6] = y_end;
+			result.evaluations += 5;
+
+			// Seven point area approximation
+			Value const area_kronrod = (h / 1470) *
+				((y[0] + y[6]) * Real(77) + (y[1] + y[5]) * Real(432) + (y[2] + y[4]) * Real(625) + y[3] * Real(672));
+
+			if (!IsFinite(area_kronrod))
+				return false;
+
+			// Four point area approximation
+			Value const area_lobatto = (h / 6) * (y[0] + y[6] + (y[2] + y[4]) * Real(5));
+
+			// Error estimate
+			Real const error = Magnitude(area_kronrod - area_lobatto);
+
+			accepted = (std::abs(h) < numeric_interval) || (++depth > MaxDepth) || (error < epsilon);
+			if (accepted)
+			{
+				result.error += error;
+				if (error >= epsilon)
+					result.status = Status::limit;
+				area = area_kronrod;
+				return true;
+			}
+
+			frames[top++] = { x, y, Value(0), depth, 0 };
+			return true;
+		};
+
+		Value const y_a = function(a);
+		Value const y_b = function(b);
+		result.evaluations = 2;
+
+		bool accepted{ false };
+		Value area(0);
+		bool finite = IsFinite(y_a) && IsFinite(y_b) && visit(a, b, y_a, y_b, 0, accepted, area);
+
+		// Depth first, as the recursion of LobattoResult
+		while (finite && top)
+		{
+			Frame& frame = frames[top - 1];
+			if (frame.next < 6)
+			{
+				uint8_t const i = frame.next++;
+				finite = visit(frame.x[i], frame.x[i + 1], frame.y[i], frame.y[i + 1], frame.depth, accepted, area);
+				if (!finite || !accepted)
+					continue;
+			}
+			else
+			{
+				area = frame.sum;
+				--top;
+				if (!top)
+					break;
+			}
+
+			// Add the area to the parent, from the first child on
+			Frame& parent = frames[top - 1];
+			parent.sum = (parent.next == 1) ? area : parent.sum + area;
+		};
+
+		if (!finite)
+		{
+			result.value = Value(NaN);
+			result.status = Status::not_finite;
+			return result;
+		}
+		result.value = area;
+		return result;
+	};
+
+	// Simpson with a_max_depth = MaxDepth
+	template <uint8_t MaxDepth, typename Function, typename Value = ValueOf<Function>>
+		requires std::invocable<Function const&, Real>
+	Value Simpson(
+		Function const& function,
+		Real a,
+		Real b,
+		Real const& a_epsilon = 1e-10)
+	{
+		static_assert(MaxDepth <= 22, "As Simpson, at most 22 levels");
+
+		if (b < a)
+			std::swap(a, b);
+
+		Real const epsilon = std::max(a_epsilon, 512 * numeric_epsilon);
+
+		// Panel halved, the halves summed so far
+		struct Frame
+		{
+			std::array<Real, 5> x;
+			std::array<Value, 5> y;
+			std::array<Value, 2> area; // Of the halves, by three points
+			Value sum;
+			Real epsilon;
+			uint8_t depth;
+			uint8_t next; // Half
+		};
+		// At least one, no frame is used at depth 0
+		std::array<Frame, std::max<std::size_t>(MaxDepth, 1)> frames;
+		std::size_t top{ 0 };
+
+		// Simpson's rule, three point area approximation
+		auto middle = [&function](
+			Real const& start,
+			Real const& end,
+			Value const& y_start,
+			Value const& y_end,
+			Real& x,
+			Value& y) -> Value
+		{
+			x = (start + end) / 2;
+			y = function(x);
+			return std::abs(end - start) * (y_start + Real(4) * y + y_end) / Real(6);
+		};
+
+		// Area of an accepted panel in 'area', or a frame pushed, false if not finite
+		auto visit = [&](
+			Real const& start,
+			Real const& center,
+			Real const& end,
+			Value const& y_start,
+			Value const& y_center,
+			Value const& y_end,
+			Value const& area_center,
+			Real const& epsilon,
+			uint8_t depth,
+			bool& accepted,
+			Value& area) -> bool
+		{
+			accepted = true;
+			if ((epsilon < numeric_epsilon) || (std::abs(end - start) < numeric_interval))
+			{
+				area = area_center;
+				return true;
+			}
+
+			std::array<Real, 5> x{ start, 0, center, 0, end };
+			std::array<Value, 5> y{ y_start, 0, y_center, 0, y_end };
+			Value const left = middle(start, center, y_start, y_center, x[1], y[1]);
+			Value const right = middle(center, end, y_center, y_end, x[3], y[3]);
+
+			if (!IsFinite(y[1]) || !IsFinite(y[3]))
+				return false;
+
+			// J. N. Lyness, modification 1 and 2, as Simpson
+			Value const error = (left + right - area_center) / Real(15);
+			if ((Magnitude(error) < epsilon) || (++depth > MaxDepth))
+			{
+				area = left + right + error;
+				return true;
+			}
+
+			accepted = false;
+			frames[top++] = { x, y, { left, right }, Value(0), epsilon / 2, depth, 0 };
+			return true;
+		};
+
+		Value const y_a = function(a);
+		Value const y_b = function(b);
+		Real x_center{ 0 };
+		Value y_center(0);
+		Value const area_center = middle(a, b, y_a, y_b, x_center, y_center);
+
+		bool accepted{ false };
+		Value area(0);
+		bool finite = IsFinite(y_a) && IsFinite(y_b) && IsFinite(y_center) &&
+			visit(a, x_center, b, y_a, y_center, y_b, area_center, epsilon, 0, accepted, area);
+
+		// Depth first, as the recursion of Simpson
+		while (finite && top)
+		{
+			Frame& frame = frames[top - 1];
+			if (frame.next < 2)
+			{
+				uint8_t const i = frame.next++;
+				std::size_t const first = 2 * i;
+				finite = visit(frame.x[first], frame.x[first + 1], frame.x[first + 2],
+					frame.y[first], frame.y[first + 1], frame.y[first + 2],
+					frame.area[i], frame.epsilon, frame.depth, accepted, area);
+				if (!finite || !accepted)
+					continue;
+			}
+			else
+			{
+				area = frame.sum;
+				--top;
+				if (!top)
+					break;
+			}
+
+			Frame& parent = frames[top - 1];
+			parent.sum = (parent.next == 1) ? area : parent.sum + area;
+		};
+
+		return finite ? area : Value(NaN);
+	};
+
+};
@@ -0,0 +1,127 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+// libquadrature.so, the C interface of capi.h
+
+#include <algorithm>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./capi.h"
+#include "./pool.hpp"
+#include "./reverse.hpp"
+
+namespace
+{
+	// Jobs on the same integrand run in lockstep, the abscissae of one
+	// Lobatto step of all of them go to the integrand in one call
+	void Lockstep(
+		std::span<quadrature_job const> jobs,
+		std::span<quadrature_result> results)
+	{
+		thread_local std::vector<Quadrature::ReverseLobatto<Real>> machines;
+		thread_local std::vector<double> x;
+		thread_local std::vector<double> y;
+		thread_local std::vector<Real> values;
+
+		machines.clear();
+		for (quadrature_job const& job : jobs)
+			machines.emplace_back(job.a, job.b, job.epsilon, static_cast<uint8_t>(std::min(job.max_depth, 255u)));
+
+		for (;;)
+		{
+			x.clear();
+			for (auto const& machine : machines)
+				for (Real const& abscissa : machine.Request())
+					x.push_back(static_cast<double>(abscissa));
+			if (x.empty())
+				break;
+
+			y.resize(x.size());
+			jobs.front().eval(x.data(), y.data(), x.size(), jobs.front().ctx);
+
+			std::size_t offset{ 0 };
+			for (auto& machine : machines)
+			{
+				std::size_t const size = machine.Request().size();
+				values.assign(y.begin() + offset, y.begin() + offset + size);
+				machine.Supply(values);
+				offset += size;
+			};
+		};
+
+		for (std::size_t i{ 0 };i < jobs.size();++i)
+		{
+			Quadrature::Result<Real> const& result = machines[i].Outcome();
+			results[i] = { static_cast<double>(result.value), static_cast<double>(result.error),
+				result.evaluations, static_cast<int>(result.status) };
+		};
+	};
+};
+
+extern "C" int quadrature_integrate(
+	quadrature_job const* jobs,
+	quadrature_result* results,
+	std::size_t const count,
+	unsigned const threads)
+{
+	if (!jobs || !results)
+		return -1;
+
+	// No exception may cross into C: allocation failures, or threads which could not start
+	try
+	{
+		// Jobs taken by a thread at once
+		std::size_t const chunk{ 64 };
+		std::size_t const chunks = (count + chunk - 1) / chunk;
+
+		unsigned const wanted = threads ? threads : std::thread::hardware_concurrency();
+		unsigned const participants = std::min<std::size_t>(wanted, chunks);
+		Quadrature::WorkIndices indices(chunks, participants);
+
+		auto task = [&]()
+		{
+			for (std::size_t c = indices.Next();c < chunks;c = indices.Next())
+			{
+				std::size_t const first = chunk * c;
+				std::size_t const last = std::min(first + chunk, count);
+				for (std::size_t begin{ first };begin < last;)
+				{
+					std::size_t end = begin + 1;
+					while ((end < last) && (jobs[end].eval == jobs[begin].eval) && (jobs[end].ctx == jobs[begin].ctx))
+						++end;
+					if (jobs[begin].eval)
+						Lockstep({ jobs + begin, end - begin }, { results + begin, end - begin });
+					else
+						for (std::size_t i{ begin };i < end;++i)
+							results[i] = { static_cast<double>(NaN), 0, 0, QUADRATURE_INVALID };
+					begin = end;
+				};
+			};
+		};
+
+		Quadrature::ThreadPool::Instance().Run(participants, task);
+	}
+	catch (...)
+	{
+		return -2;
+	};
+
+	return 0;
+};
@@ -0,0 +1,77 @@
+/* Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+ *
+ * Licensed under the GNU Lesser General Public License, version 3.0 or later
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or ( at your option ) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+ */
+
+/* C interface of libquadrature.so, integrates arrays of jobs in one call.
+ * Integrands use the batch entry point of plugin.h,
+ * and are called from several threads at the same time.
+ */
+
+#ifndef QUADRATURE_CAPI_H
+#define QUADRATURE_CAPI_H
+
+#include <stddef.h>
+
+#include "plugin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Status of a result, as Quadrature::Status */
+#define QUADRATURE_CONVERGED 0
+#define QUADRATURE_LIMIT 1
+#define QUADRATURE_NOT_FINITE 2
+#define QUADRATURE_INVALID 3
+
+/* Lobatto rule for f from a to b */
+typedef struct
+{
+	quadrature_eval eval;
+	void* ctx;
+	double a;
+	double b;
+	double epsilon; /* Absolute error per interval, e.g. 1e-10 */
+	unsigned max_depth; /* Recursive depth, at most 8, e.g. 2 */
+} quadrature_job;
+
+typedef struct
+{
+	double value;
+	double error;
+	size_t evaluations;
+	int status;
+} quadrature_result;
+
+/* Integrates jobs[i] into results[i], for 'count' jobs, on at most 'threads' threads
+ * (0 for all cores). Consecutive jobs with the same eval and ctx share integrand calls.
+ * The threads come from one pool for the process: a call made while another thread's call
+ * is running does not wait for it, it runs on the calling thread alone.
+ * Returns 0, -1 if an array is NULL, or -2 if memory or threads ran out.
+ * After -2 no thread touches the arrays any more, and each result is either
+ * complete or left as it was before the call. */
+int quadrature_integrate(
+	const quadrature_job* jobs,
+	quadrature_result* results,
+	size_t count,
+	unsigned threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
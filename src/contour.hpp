@@ -0,0 +1,242 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <concepts>
+#include <functional>
+#include <span>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./pool.hpp"
+
+// Contour integrals of f(z) dz in the complex plane,
+// along a path of line segments, arcs and circles
+namespace Quadrature
+{
+	using Complex = std::complex<Real>;
+
+	// Straight line from 'start' to 'end'
+	struct Segment
+	{
+		Complex start;
+		Complex end;
+	};
+
+	// Arc around 'center', from angle 'start' to 'end' (radians),
+	// counter clockwise if end > start
+	struct Arc
+	{
+		Complex center;
+		Real radius;
+		Real start;
+		Real end;
+	};
+
+	// Closed circle around 'center', counter clockwise
+	struct Circle
+	{
+		Complex center;
+		Real radius;
+	};
+
+	using Piece = std::variant<Segment, Arc, Circle>;
+
+	// Trapezoidal rule on a closed circle, which converges exponentially for analytic f.
+	// The number of points is doubled, reusing the previous ones, until two estimates agree.
+	// The Exponentially Convergent Trapezoidal Rule
+	// Lloyd N. Trefethen, J. A. C. Weideman
+	template <typename Function>
+	Result<Complex> Trapezoid(
+		Function const& function,
+		Circle const& circle,
+		Real const& a_epsilon = 1e-10,
+		uint8_t const& a_max_depth = 16)
+	{
+		// Maximal points 8 * 2^16 ~= 500 thousand
+		uint8_t const max_depth = std::min(a_max_depth, static_cast<uint8_t>(16));
+		Real const epsilon = std::max(a_epsilon, numeric_epsilon);
+
+		Result<Complex> result;
+
+		// f(z) dz/dtheta at angle theta
+		auto integrand = [&](Real const& theta) -> Complex
+		{
+			Complex const rotation = std::polar(Real(1), theta);
+			return function(circle.center + circle.radius * rotation) * Complex(0, circle.radius) * rotation;
+		};
+
+		std::size_t n{ 8 };
+		Complex sum{ 0 };
+		for (std::size_t k{ 0 };k < n;++k)
+			sum += integrand(2 * pi * k / n);
+		result.evaluations = n;
+		Complex estimate = sum * (2 * pi / n);
+
+		for (uint8_t depth{ 0 };;++depth)
+		{
+			if (!IsFinite(estimate))
+			{
+				result.value = Complex(NaN);
+				result.status = Status::not_finite;
+				return result;
+			}
+			if (depth >= max_depth)
+			{
+				result.status = Status::limit;
+				break;
+			}
+
+			// New points halfway between the previous ones
+			for (std::size_t k{ 0 };k < n;++k)
+				sum += integrand(2 * pi * (2 * k + 1) / (2 * n));
+			result.evaluations += n;
+			n *= 2;
+
+			Complex const refined = sum * (2 * pi / n);
+			result.error = Magnitude(refined - estimate);
+			estimate = refined;
+			if (result.error < epsilon)
+				break;
+		};
+
+		result.value = estimate;
+		return result;
+	};
+
+	// Integral of f(z) dz along a path.
+	// Segments and arcs use LobattoResult on their parametrisation, circles the trapezoidal rule.
+	// Pieces are integrated concurrently (f is called from several threads),
+	// and f is evaluated once at each end point, which adjacent pieces share.
+	//
+	// Returns the sum of the pieces, with the sum of their errors and evaluations.
+	template <typename Function>
+		requires std::invocable<Function const&, Complex>
+	Result<Complex> Contour(
+		Function const& function,
+		std::span<Piece const> path,
+		Real const& a_epsilon = 1e-10,
+		uint8_t const& a_max_depth = 2,
+		unsigned const a_threads = std::thread::hardware_concurrency())
+	{
+		Result<Complex> result;
+		unsigned const threads = std::max(a_threads, 1u);
+
+		// End points of the segments and arcs, each evaluated once
+		std::vector<Complex> vertices;
+		auto ends = [](Piece const& piece) -> std::array<Complex, 2>
+		{
+			if (auto const* segment = std::get_if<Segment>(&piece))
+				return { segment->start, segment->end };
+			Arc const& arc = std::get<Arc>(piece);
+			return { arc.center + std::polar(arc.radius, arc.start), arc.center + std::polar(arc.radius, arc.end) };
+		};
+		for (Piece const& piece : path)
+		{
+			if (std::holds_alternative<Circle>(piece))
+				continue;
+			for (Complex const& z : ends(piece))
+				if (std::find(vertices.begin(), vertices.end(), z) == vertices.end())
+					vertices.push_back(z);
+		};
+
+		std::vector<Complex> vertex_values(vertices.size());
+		for (std::size_t i{ 0 };i < vertices.size();++i)
+			vertex_values[i] = function(vertices[i]);
+		result.evaluations = vertices.size();
+
+		auto vertex = [&](Complex const& z) -> Complex
+		{
+			return vertex_values[std::find(vertices.begin(), vertices.end(), z) - vertices.begin()];
+		};
+
+		std::vector<Result<Complex>> pieces(path.size());
+		unsigned const participants = std::min<std::size_t>(threads, path.size());
+		WorkIndices indices(path.size(), participants);
+
+		auto worker = [&]()
+		{
+			for (std::size_t i = indices.Next();i < path.size();i = indices.Next())
+			{
+				Piece const& piece = path[i];
+				if (auto const* circle = std::get_if<Circle>(&piece))
+				{
+					pieces[i] = Trapezoid(function, *circle, a_epsilon);
+					continue;
+				}
+
+				// Values at the ends of the parameter interval come from the vertices,
+				// Lobatto calls them with exactly 'a' and 'b'
+				std::array<Complex, 2> const z = ends(piece);
+				std::array<Complex, 2> const f{ vertex(z[0]), vertex(z[1]) };
+
+				if (auto const* segment = std::get_if<Segment>(&piece))
+				{
+					Complex const dz = segment->end - segment->start;
+					auto integrand = [&](Real const& t) -> Complex
+					{
+						if (t == 0)
+							return f[0] * dz;
+						if (t == 1)
+							return f[1] * dz;
+						return function(segment->start + t * dz) * dz;
+					};
+					pieces[i] = LobattoResult(integrand, 0, 1, a_epsilon, a_max_depth);
+				}
+				else
+				{
+					Arc const& arc = std::get<Arc>(piece);
+					auto integrand = [&](Real const& theta) -> Complex
+					{
+						Complex const rotation = std::polar(Real(1), theta);
+						Complex const dz = Complex(0, arc.radius) * rotation;
+						if (theta == arc.start)
+							return f[0] * dz;
+						if (theta == arc.end)
+							return f[1] * dz;
+						return function(arc.center + arc.radius * rotation) * dz;
+					};
+					// Lobatto integrates over the unordered interval
+					Real const sign = (arc.end < arc.start) ? -1 : 1;
+					pieces[i] = LobattoResult(integrand, arc.start, arc.end, a_epsilon, a_max_depth);
+					pieces[i].value *= sign;
+				};
+				// End points were counted with the vertices
+				pieces[i].evaluations -= 2;
+			};
+		};
+
+		ThreadPool::Instance().Run(participants, worker);
+
+		for (Result<Complex> const& piece : pieces)
+		{
+			result.value += piece.value;
+			result.error += piece.error;
+			result.evaluations += piece.evaluations;
+			if (piece.status > result.status)
+				result.status = piece.status;
+		};
+		return result;
+	};
+
+};
@@ -0,0 +1,334 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./panel.hpp"
+
+// Adaptive numerical integration over a hyperrectangle [a;b],
+// limited by the number of integrand evaluations
+namespace Quadrature
+{
+	// An Adaptive Algorithm for Numerical Integration over an N-Dimensional Rectangular Region
+	// A. C. Genz, A. A. Malik
+	//
+	// Degree 7 rule with embedded degree 5 rule, d = 2 to 10 dimensions.
+	// Global adaptive: the box with the largest error is split in two,
+	// along the dimension with the largest fourth difference.
+	//
+	// The integrand is called with a batch of points (point major, d per point)
+	// and writes 'components' values per point:
+	//   void integrand(std::span<Real const> points, std::span<Real> values)
+	//
+	// Returns NaN components if the integrand is not finite,
+	// or if the dimension is not supported.
+	template <typename Integrand>
+	Result<std::vector<Real>> GenzMalik(
+		Integrand const& integrand,
+		std::size_t const components,
+		std::span<Real const> a,
+		std::span<Real const> b,
+		Real const& a_epsilon = 1e-10,
+		std::size_t const max_evaluations = 1'000'000)
+	{
+		Result<std::vector<Real>> result;
+		result.value.assign(components, 0);
+
+		std::size_t const d = a.size();
+		if ((d < 2) || (d > 10) || (b.size() != d) || !components)
+		{
+			std::fill(result.value.begin(), result.value.end(), NaN);
+			result.status = Status::invalid;
+			return result;
+		}
+
+		Real const epsilon = std::max(a_epsilon, numeric_epsilon);
+
+		// Generators, on [-1;1]^d
+		Real static const lambda2 = std::sqrt(Real(9) / Real(70));
+		Real static const lambda3 = std::sqrt(Real(9) / Real(10));
+		Real static const lambda4 = std::sqrt(Real(9) / Real(10));
+		Real static const lambda5 = std::sqrt(Real(9) / Real(19));
+
+		// Weights, normalised to a unit volume
+		Real const n = static_cast<Real>(d);
+		Real const w1 = (12824 - 9120 * n + 400 * n * n) / 19683;
+		Real const w2 = Real(980) / 6561;
+		Real const w3 = (1820 - 400 * n) / 19683;
+		Real const w4 = Real(200) / 19683;
+		Real const w5 = Real(6859) / 19683 / static_cast<Real>(std::size_t(1) << d);
+		// Embedded degree 5 rule
+		Real const e1 = (729 - 950 * n + 50 * n * n) / 729;
+		Real const e2 = Real(245) / 486;
+		Real const e3 = (265 - 100 * n) / 1458;
+		Real const e4 = Real(25) / 729;
+
+		// Fourth difference ratio, lambda2^2 / lambda3^2
+		Real const ratio = Real(1) / Real(7);
+
+		std::size_t const points = 1 + 4 * d + 2 * d * (d - 1) + (std::size_t(1) << d);
+
+		// Box arena, one record per box, indexed by the queue.
+		// A split box recycles its slot for the lower half.
+		struct Arena
+		{
+			std::vector<Real> geometry; // d centers, then d half widths
+			std::vector<Real> estimate; // 'components' per box
+			std::vector<Real> error; // 'components' per box
+			std::vector<Real> priority; // Largest component error
+		} arena;
+
+		PanelQueue queue(arena.priority);
+
+		std::vector<Real> batch_points;
+		std::vector<Real> batch_values;
+
+		auto center = [&](std::size_t const& box) -> Real* { return &arena.geometry[2 * d * box]; };
+		auto width = [&](std::size_t const& box) -> Real* { return &arena.geometry[2 * d * box + d]; };
+
+		// Append the rule's points of a box to the batch
+		auto generate = [&](std::size_t const& box)
+		{
+			Real const* c = center(box);
+			Real const* h = width(box);
+
+			std::size_t offset = batch_points.size();
+			batch_points.resize(offset + points * d);
+			Real* p = &batch_points[offset];
+
+			auto add = [&]() -> Real*
+			{
+				std::copy(c, c + d, p);
+				p += d;
+				return p - d;
+			};
+
+			add();
+			for (std::size_t i{ 0 };i < d;++i)
+			{
+				add()[i] -= lambda2 * h[i];
+				add()[i] += lambda2 * h[i];
+				add()[i] -= lambda3 * h[i];
+				add()[i] += lambda3 * h[i];
+			};
+			for (std::size_t i{ 0 };i < d;++i)
+				for (std::size_t j{ i + 1 };j < d;++j)
+					for (uint8_t sign{ 0 };sign < 4;++sign)
+					{
+						Real* q = add();
+						q[i] += ((sign & 1) ? lambda4 : -lambda4) * h[i];
+						q[j] += ((sign & 2) ? lambda4 : -lambda4) * h[j];
+					};
+			for (std::size_t corner{ 0 };corner < (std::size_t(1) << d);++corner)
+			{
+				Real* q = add();
+				for (std::size_t i{ 0 };i < d;++i)
+					q[i] += (((corner >> i) & 1) ? lambda5 : -lambda5) * h[i];
+			};
+		};
+
+		// Apply the rule to a box, from its values in the batch.
+		// Returns the dimension with the largest fourth difference.
+		auto apply = [&](std::size_t const& box, Real const* f) -> std::size_t
+		{
+			Real const* h = width(box);
+			Real volume{ 1 };
+			for (std::size_t i{ 0 };i < d;++i)
+				volume *= 2 * h[i];
+
+			std::size_t split{ 0 };
+			Real split_difference{ -1 };
+			for (std::size_t i{ 0 };i < d;++i)
+			{
+				Real difference{ 0 };
+				for (std::size_t k{ 0 };k < components;++k)
+				{
+					Real const* v = f + (1 + 4 * i) * components + k;
+					difference += std::abs(v[0] + v[components] - 2 * f[k] -
+						ratio * (v[2 * components] + v[3 * components] - 2 * f[k]));
+				};
+				// Ties are split along the widest dimension
+				if ((difference > split_difference) ||
+					((difference == split_difference) && (h[i] > h[split])))
+				{
+					split = i;
+					split_difference = difference;
+				};
+			};
+
+			Real priority{ 0 };
+			for (std::size_t k{ 0 };k < components;++k)
+			{
+				Real sum2{ 0 }, sum3{ 0 }, sum4{ 0 }, sum5{ 0 };
+				std::size_t p{ 1 };
+				for (std::size_t i{ 0 };i < d;++i, p += 4)
+				{
+					sum2 += f[p * components + k] + f[(p + 1) * components + k];
+					sum3 += f[(p + 2) * components + k] + f[(p + 3) * components + k];
+				};
+				for (;p < points - (std::size_t(1) << d);++p)
+					sum4 += f[p * components + k];
+				for (;p < points;++p)
+					sum5 += f[p * components + k];
+
+				Real const degree7 = volume * (w1 * f[k] + w2 * sum2 + w3 * sum3 + w4 * sum4 + w5 * sum5);
+				Real const degree5 = volume * (e1 * f[k] + e2 * sum2 + e3 * sum3 + e4 * sum4);
+
+				arena.estimate[box * components + k] = degree7;
+				arena.error[box * components + k] = std::abs(degree7 - degree5);
+				priority = std::max(priority, std::abs(degree7 - degree5));
+			};
+			arena.priority[box] = priority;
+			return split;
+		};
+
+		auto allocate = [&]() -> std::size_t
+		{
+			arena.geometry.resize(arena.geometry.size() + 2 * d);
+			arena.estimate.resize(arena.estimate.size() + components);
+			arena.error.resize(arena.error.size() + components);
+			arena.priority.push_back(0);
+			return arena.priority.size() - 1;
+		};
+
+		// Evaluate the integrand over all points in the batch
+		auto evaluate = [&](std::size_t const& boxes) -> bool
+		{
+			batch_values.resize(boxes * points * components);
+			integrand(std::span<Real const>(batch_points), std::span<Real>(batch_values));
+			result.evaluations += boxes * points;
+			return std::all_of(batch_values.begin(), batch_values.end(),
+				[](Real const& y) -> bool { return std::isfinite(y); });
+		};
+
+		// Split dimension of each box, used when it is popped
+		std::vector<std::size_t> splits;
+
+		std::size_t const root = allocate();
+		for (std::size_t i{ 0 };i < d;++i)
+		{
+			center(root)[i] = (a[i] + b[i]) / 2;
+			// As with the 1D engines, bounds may be given in either order
+			width(root)[i] = std::abs(b[i] - a[i]) / 2;
+		};
+		generate(root);
+		if (!evaluate(1))
+		{
+			std::fill(result.value.begin(), result.value.end(), NaN);
+			result.status = Status::not_finite;
+			return result;
+		}
+		splits.push_back(apply(root, batch_values.data()));
+		queue.Push(root);
+
+		std::vector<Real> total_error(arena.error.begin(), arena.error.end());
+
+		auto converged = [&]() -> bool
+		{
+			return std::all_of(total_error.begin(), total_error.end(),
+				[&epsilon](Real const& e) -> bool { return e < epsilon; });
+		};
+
+		while (!converged())
+		{
+			if (result.evaluations + 2 * points > max_evaluations)
+			{
+				result.status = Status::limit;
+				break;
+			}
+
+			std::size_t const lower = queue.Pop();
+
+			for (std::size_t k{ 0 };k < components;++k)
+				total_error[k] -= arena.error[lower * components + k];
+
+			// Halve the box, lower half keeps the slot
+			std::size_t const split = splits[lower];
+			std::size_t const upper = allocate();
+			std::copy(center(lower), center(lower) + 2 * d, center(upper));
+			width(lower)[split] /= 2;
+			width(upper)[split] /= 2;
+			center(lower)[split] -= width(lower)[split];
+			center(upper)[split] += width(upper)[split];
+
+			batch_points.clear();
+			generate(lower);
+			generate(upper);
+			if (!evaluate(2))
+			{
+				std::fill(result.value.begin(), result.value.end(), NaN);
+				result.status = Status::not_finite;
+				return result;
+			}
+
+			splits.resize(arena.priority.size());
+			splits[lower] = apply(lower, batch_values.data());
+			splits[upper] = apply(upper, batch_values.data() + points * components);
+
+			for (std::size_t box : { lower, upper })
+			{
+				for (std::size_t k{ 0 };k < components;++k)
+					total_error[k] += arena.error[box * components + k];
+				queue.Push(box);
+			};
+		};
+
+		// Sum afresh, rather than from the running totals
+		for (std::size_t k{ 0 };k < components;++k)
+		{
+			Real value{ 0 }, error{ 0 };
+			for (std::size_t box{ 0 };box < arena.priority.size();++box)
+			{
+				value += arena.estimate[box * components + k];
+				error += arena.error[box * components + k];
+			};
+			result.value[k] = value;
+			result.error = std::max(result.error, error);
+		};
+
+		return result;
+	};
+
+	// Scalar integrand, evaluated one point at a time
+	//   Real function(std::span<Real const> x)
+	template <typename Function>
+		requires std::invocable<Function const&, std::span<Real const>>
+	Result<Real> GenzMalik(
+		Function const& function,
+		std::span<Real const> a,
+		std::span<Real const> b,
+		Real const& a_epsilon = 1e-10,
+		std::size_t const max_evaluations = 1'000'000)
+	{
+		std::size_t const d = a.size();
+		auto batch = [&function, &d](std::span<Real const> points, std::span<Real> values)
+		{
+			for (std::size_t i{ 0 };i < values.size();++i)
+				values[i] = function(points.subspan(i * d, d));
+		};
+
+		auto const vector = GenzMalik(batch, 1, a, b, a_epsilon, max_evaluations);
+		return Result<Real>{ vector.value.front(), vector.error, vector.evaluations, vector.status };
+	};
+
+};
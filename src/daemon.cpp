@@ -0,0 +1,427 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+// Integration daemon, listens on a Unix socket for jobs on named integrands,
+// see protocol.hpp. The thread pool and the rules live as long as the daemon.
+//
+//	./bin/daemon [socket path] [plugin.so ...]
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cerrno>
+#include <csignal>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "./quadrature.hpp"
+#include "./plugin.hpp"
+#include "./protocol.hpp"
+#include "./registry.hpp"
+#include "./reverse.hpp"
+
+namespace
+{
+	std::atomic<bool> running{ true };
+
+	// Client socket, kept by the listening loop until the client stopped sending,
+	// its jobs are answered and the replies are written
+	struct Connection : std::enable_shared_from_this<Connection>
+	{
+		// Replies waiting for a slow client, beyond which it is dropped
+		static constexpr std::size_t max_output{ 1 << 26 };
+
+		int socket;
+		std::vector<char> input; // Listening loop only
+		Quadrature::Protocol::Decoder decoder;
+		bool reading{ true };
+		std::atomic<std::size_t> jobs{ 0 }; // Not yet answered
+
+		explicit Connection(int const socket)
+			: socket(socket) {
+		};
+		~Connection()
+		{
+			close(socket);
+		};
+
+		// Queued, and written as far as the socket takes it without blocking,
+		// the listening loop writes the rest
+		void Send(Quadrature::Protocol::Reply const& reply)
+		{
+			std::lock_guard lock(mutex);
+			if (broken)
+				return;
+			Quadrature::Protocol::Encode(reply, output);
+			if (output.size() > max_output)
+			{
+				Break();
+				return;
+			}
+			Write();
+		};
+
+		// Writes queued replies, from the listening loop once the socket takes more
+		void Flush()
+		{
+			std::lock_guard lock(mutex);
+			if (!broken)
+				Write();
+		};
+
+		bool Pending()
+		{
+			std::lock_guard lock(mutex);
+			return !output.empty();
+		};
+
+	private:
+		void Write()
+		{
+			std::size_t sent{ 0 };
+			while (sent < output.size())
+			{
+				ssize_t const n = send(socket, output.data() + sent, output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+				if (n > 0)
+				{
+					sent += n;
+					continue;
+				}
+				if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+					break;
+				if ((n < 0) && (errno == EINTR))
+					continue;
+				Break();
+				return;
+			};
+			output.erase(output.begin(), output.begin() + sent);
+		};
+
+		// The client is gone or does not read, replies are dropped
+		void Break()
+		{
+			broken = true;
+			output.clear();
+			output.shrink_to_fit();
+			shutdown(socket, SHUT_RDWR);
+		};
+
+		std::mutex mutex;
+		std::vector<char> output;
+		bool broken{ false };
+	};
+
+	struct Job
+	{
+		std::shared_ptr<Connection> connection;
+		Quadrature::Protocol::Job job;
+	};
+
+	// Jobs waiting for a worker
+	class Queue
+	{
+	public:
+		void Push(std::vector<Job>& jobs)
+		{
+			{
+				std::lock_guard lock(mutex);
+				for (Job& job : jobs)
+					waiting.push_back(std::move(job));
+			}
+			condition.notify_all();
+		};
+
+		// Blocks for the first job, false when stopping
+		bool Pop(Job& job)
+		{
+			std::unique_lock lock(mutex);
+			condition.wait(lock, [this]() -> bool { return !waiting.empty() || !running; });
+			if (waiting.empty())
+				return false;
+			job = std::move(waiting.front());
+			waiting.pop_front();
+			return true;
+		};
+
+		// Up to 'count' more jobs on the same integrand, without blocking
+		void Take(
+			std::string const& name,
+			std::size_t count,
+			std::vector<Job>& jobs)
+		{
+			std::lock_guard lock(mutex);
+			for (auto job = waiting.begin();(job != waiting.end()) && count;)
+			{
+				if (job->job.name != name)
+				{
+					++job;
+					continue;
+				}
+				jobs.push_back(std::move(*job));
+				job = waiting.erase(job);
+				--count;
+			};
+		};
+
+		// After 'running' is cleared, taking the lock orders it before any wait
+		void Wake()
+		{
+			{
+				std::lock_guard lock(mutex);
+			}
+			condition.notify_all();
+		};
+
+	private:
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Job> waiting;
+	};
+
+	void Reply(
+		Job const& job,
+		Quadrature::Result<Real> const& result)
+	{
+		job.connection->Send({ job.job.id, double(result.value), double(result.error),
+			result.evaluations, static_cast<uint8_t>(result.status) });
+		--job.connection->jobs;
+	};
+
+	// Jobs on the same integrand run in lockstep, the abscissae of all their
+	// Lobatto steps go to the integrand in one batch. Finished jobs are
+	// answered at once, and replaced by waiting jobs on the same integrand.
+	void Worker(
+		Queue& queue,
+		Quadrature::Registry const& registry,
+		std::size_t const batch)
+	{
+		struct Active
+		{
+			Job job;
+			Quadrature::ReverseLobatto<Real> machine;
+		};
+
+		std::vector<Job> incoming;
+		std::vector<Active> active;
+		std::vector<Real> x;
+		std::vector<Real> y;
+		std::vector<std::size_t> offsets;
+
+		Job first;
+		while (queue.Pop(first))
+		{
+			std::string const name = first.job.name;
+			Quadrature::Batch const* integrand = registry.Find(name);
+
+			incoming.clear();
+			incoming.push_back(std::move(first));
+			queue.Take(name, batch - 1, incoming);
+
+			while (!incoming.empty() || !active.empty())
+			{
+				for (Job& job : incoming)
+				{
+					if (!integrand)
+					{
+						Quadrature::Result<Real> invalid;
+						invalid.value = NaN;
+						invalid.status = Quadrature::Status::invalid;
+						Reply(job, invalid);
+						continue;
+					}
+					Quadrature::ReverseLobatto<Real> machine(job.job.a, job.job.b, job.job.epsilon, job.job.max_depth);
+					active.push_back({ std::move(job), std::move(machine) });
+				};
+				incoming.clear();
+				if (active.empty())
+					break;
+
+				x.clear();
+				offsets.clear();
+				for (Active const& a : active)
+				{
+					offsets.push_back(x.size());
+					std::span<Real const> const request = a.machine.Request();
+					x.insert(x.end(), request.begin(), request.end());
+				};
+				y.resize(x.size());
+				(*integrand)(x, y);
+
+				for (std::size_t i{ 0 };i < active.size();++i)
+				{
+					std::size_t const size = active[i].machine.Request().size();
+					active[i].machine.Supply(std::span<Real const>(y).subspan(offsets[i], size));
+				};
+
+				std::erase_if(active, [](Active& a) -> bool
+					{
+						if (!a.machine.Done())
+							return false;
+						Reply(a.job, a.machine.Outcome());
+						return true;
+					});
+
+				queue.Take(name, batch - active.size(), incoming);
+			};
+		};
+	};
+
+	// Built in integrands, the functions of the main.cpp examples
+	void Builtin(Quadrature::Registry& registry)
+	{
+		registry.Add("sin", [](Real const& x) -> Real { return std::sin(x); });
+		registry.Add("poly", [](Real const& x) -> Real { return 6 * x * x - 8 * x + 5; });
+		registry.Add("log", [](Real const& x) -> Real { return std::log(x); });
+		registry.Add("sqrt", [](Real const& x) -> Real { return std::sqrt(x) + 1 / (3 * std::sqrt(x)); });
+	};
+
+	void Stop(int)
+	{
+		running = false;
+	};
+};
+
+int main(int argc, char* argv[])
+{
+	std::string const path = (argc > 1) ? argv[1] : "/tmp/quadrature.sock";
+
+	// Jobs on one integrand taken by a worker at once
+	std::size_t const batch{ 256 };
+
+	Quadrature::Registry registry;
+	Builtin(registry);
+	for (int i{ 2 };i < argc;++i)
+		if (!Quadrature::LoadPlugin(registry, argv[i]))
+			std::cerr << "daemon: no integrands loaded from " << argv[i] << "\n";
+
+	int const listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if ((listener < 0) || (path.size() >= sizeof(address.sun_path)))
+	{
+		std::cerr << "daemon: invalid socket " << path << "\n";
+		return 1;
+	}
+	path.copy(address.sun_path, path.size());
+	unlink(path.c_str());
+	if ((bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) < 0) || (listen(listener, 64) < 0))
+	{
+		std::cerr << "daemon: cannot listen on " << path << "\n";
+		return 1;
+	}
+
+	std::signal(SIGINT, Stop);
+	std::signal(SIGTERM, Stop);
+
+	Queue queue;
+	std::vector<std::jthread> pool;
+	for (unsigned t{ 0 };t < std::max(std::thread::hardware_concurrency(), 1u);++t)
+		pool.emplace_back(Worker, std::ref(queue), std::cref(registry), batch);
+
+	std::vector<std::shared_ptr<Connection>> connections;
+	std::vector<pollfd> descriptors;
+	std::vector<Connection*> polled; // By descriptor, after the listener
+	std::vector<Job> jobs;
+	std::vector<Quadrature::Protocol::Job> decoded;
+	char buffer[1 << 16];
+
+	while (running)
+	{
+		// Done once the client stopped sending, and its replies are written
+		std::erase_if(connections, [](std::shared_ptr<Connection> const& connection) -> bool
+			{
+				return !connection->reading && !connection->jobs && !connection->Pending();
+			});
+
+		// Only those waited on, a hung up socket would wake poll at once
+		descriptors.assign(1, { listener, POLLIN, 0 });
+		polled.clear();
+		for (auto const& connection : connections)
+		{
+			short const events = (connection->reading ? POLLIN : 0) | (connection->Pending() ? POLLOUT : 0);
+			if (!events)
+				continue;
+			descriptors.push_back({ connection->socket, events, 0 });
+			polled.push_back(connection.get());
+		};
+
+		// Time out to notice a stop signal, and replies queued by the workers
+		if (poll(descriptors.data(), descriptors.size(), 200) <= 0)
+			continue;
+
+		if (descriptors[0].revents & POLLIN)
+		{
+			int const client = accept(listener, nullptr, nullptr);
+			if (client >= 0)
+				connections.push_back(std::make_shared<Connection>(client));
+		}
+
+		for (std::size_t c{ 1 };c < descriptors.size();++c)
+		{
+			if (!descriptors[c].revents)
+				continue;
+			Connection* const connection = polled[c - 1];
+
+			// A failed write drops the replies of a client that hung up
+			if (connection->Pending() && (descriptors[c].revents & (POLLOUT | POLLHUP | POLLERR)))
+				connection->Flush();
+			if (!connection->reading || !(descriptors[c].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+
+			ssize_t const n = recv(connection->socket, buffer, sizeof(buffer), 0);
+			if (n <= 0)
+			{
+				// Jobs in flight are still answered
+				connection->reading = false;
+				continue;
+			}
+			connection->input.insert(connection->input.end(), buffer, buffer + n);
+
+			// Less than a job is kept between reads, as jobs are decoded as soon as they are complete
+			decoded.clear();
+			bool valid{ true };
+			std::size_t const used = connection->decoder.Feed(connection->input, decoded, valid);
+			connection->input.erase(connection->input.begin(), connection->input.begin() + used);
+
+			jobs.clear();
+			for (Quadrature::Protocol::Job& job : decoded)
+				jobs.push_back({ connection->shared_from_this(), std::move(job) });
+			connection->jobs += jobs.size();
+			queue.Push(jobs);
+
+			if (!valid)
+				connection->reading = false;
+		};
+	};
+
+	queue.Wake();
+	pool.clear();
+	close(listener);
+	unlink(path.c_str());
+	return 0;
+};
@@ -0,0 +1,199 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "./quadrature.hpp"
+
+// Forward mode automatic differentiation, so the engines return
+// an integral and its derivatives with respect to N parameters in one pass
+namespace Quadrature
+{
+	// Value with its gradient, the N derivative lanes are contiguous,
+	// so each operation is a loop the compiler can vectorise
+	template <std::size_t N>
+	struct Dual
+	{
+		Real value{ 0 };
+		std::array<Real, N> gradient{};
+
+		Dual() {};
+		Dual(Real const& value)
+			: value(value) {
+		};
+		Dual(Real const& value, std::array<Real, N> const& gradient)
+			: value(value), gradient(gradient) {
+		};
+
+		// Parameter 'index', with derivative 1 with respect to itself
+		static Dual Variable(Real const& value, std::size_t const& index)
+		{
+			Dual variable(value);
+			variable.gradient[index] = 1;
+			return variable;
+		};
+
+		Dual& operator+=(Dual const& rhs)
+		{
+			value += rhs.value;
+			for (std::size_t i{ 0 };i < N;++i)
+				gradient[i] += rhs.gradient[i];
+			return *this;
+		};
+
+		Dual& operator-=(Dual const& rhs)
+		{
+			value -= rhs.value;
+			for (std::size_t i{ 0 };i < N;++i)
+				gradient[i] -= rhs.gradient[i];
+			return *this;
+		};
+
+		Dual& operator*=(Dual const& rhs)
+		{
+			for (std::size_t i{ 0 };i < N;++i)
+				gradient[i] = gradient[i] * rhs.value + value * rhs.gradient[i];
+			value *= rhs.value;
+			return *this;
+		};
+
+		Dual& operator/=(Dual const& rhs)
+		{
+			Real const inverse = 1 / rhs.value;
+			value *= inverse;
+			for (std::size_t i{ 0 };i < N;++i)
+				gradient[i] = (gradient[i] - value * rhs.gradient[i]) * inverse;
+			return *this;
+		};
+	};
+
+	template <std::size_t N>
+	Dual<N> operator-(Dual<N> x)
+	{
+		x.value = -x.value;
+		for (Real& g : x.gradient)
+			g = -g;
+		return x;
+	};
+
+	template <std::size_t N>
+	Dual<N> operator+(Dual<N> lhs, Dual<N> const& rhs) { return lhs += rhs; };
+	template <std::size_t N>
+	Dual<N> operator-(Dual<N> lhs, Dual<N> const& rhs) { return lhs -= rhs; };
+	template <std::size_t N>
+	Dual<N> operator*(Dual<N> lhs, Dual<N> const& rhs) { return lhs *= rhs; };
+	template <std::size_t N>
+	Dual<N> operator/(Dual<N> lhs, Dual<N> const& rhs) { return lhs /= rhs; };
+
+	// Mixed with Real, without promoting the Real to a Dual
+	template <std::size_t N>
+	Dual<N> operator+(Dual<N> lhs, Real const& rhs) { lhs.value += rhs; return lhs; };
+	template <std::size_t N>
+	Dual<N> operator+(Real const& lhs, Dual<N> rhs) { rhs.value += lhs; return rhs; };
+	template <std::size_t N>
+	Dual<N> operator-(Dual<N> lhs, Real const& rhs) { lhs.value -= rhs; return lhs; };
+	template <std::size_t N>
+	Dual<N> operator-(Real const& lhs, Dual<N> const& rhs) { return -rhs + lhs; };
+
+	template <std::size_t N>
+	Dual<N> operator*(Dual<N> lhs, Real const& rhs)
+	{
+		lhs.value *= rhs;
+		for (Real& g : lhs.gradient)
+			g *= rhs;
+		return lhs;
+	};
+	template <std::size_t N>
+	Dual<N> operator*(Real const& lhs, Dual<N> const& rhs) { return rhs * lhs; };
+	template <std::size_t N>
+	Dual<N> operator/(Dual<N> const& lhs, Real const& rhs) { return lhs * (1 / rhs); };
+	template <std::size_t N>
+	Dual<N> operator/(Real const& lhs, Dual<N> const& rhs) { return Dual<N>(lhs) /= rhs; };
+
+	template <std::size_t N>
+	bool operator<(Dual<N> const& lhs, Dual<N> const& rhs) { return lhs.value < rhs.value; };
+
+	// Chain rule, f(x) with derivative f'(x)
+	template <std::size_t N>
+	Dual<N> Chain(Dual<N> x, Real const& f, Real const& derivative)
+	{
+		x.value = f;
+		for (Real& g : x.gradient)
+			g *= derivative;
+		return x;
+	};
+
+	// Elementary functions, found by argument dependent lookup:
+	// call them unqualified, sin(x) rather than std::sin(x)
+	template <std::size_t N>
+	Dual<N> sin(Dual<N> const& x) { return Chain(x, std::sin(x.value), std::cos(x.value)); };
+	template <std::size_t N>
+	Dual<N> cos(Dual<N> const& x) { return Chain(x, std::cos(x.value), -std::sin(x.value)); };
+	template <std::size_t N>
+	Dual<N> tan(Dual<N> const& x)
+	{
+		Real const t = std::tan(x.value);
+		return Chain(x, t, 1 + t * t);
+	};
+	template <std::size_t N>
+	Dual<N> exp(Dual<N> const& x)
+	{
+		Real const e = std::exp(x.value);
+		return Chain(x, e, e);
+	};
+	template <std::size_t N>
+	Dual<N> log(Dual<N> const& x) { return Chain(x, std::log(x.value), 1 / x.value); };
+	template <std::size_t N>
+	Dual<N> sqrt(Dual<N> const& x)
+	{
+		Real const s = std::sqrt(x.value);
+		return Chain(x, s, 1 / (2 * s));
+	};
+	template <std::size_t N>
+	Dual<N> abs(Dual<N> const& x) { return (x.value < 0) ? -x : x; };
+	template <std::size_t N>
+	Dual<N> pow(Dual<N> const& x, Real const& y)
+	{
+		Real const p = std::pow(x.value, y);
+		return Chain(x, p, y * std::pow(x.value, y - 1));
+	};
+	template <std::size_t N>
+	Dual<N> pow(Dual<N> const& x, Dual<N> const& y) { return exp(y * log(x)); };
+
+	// Engine hooks, a Dual is finite if all lanes are,
+	// and the error test covers the derivatives as well as the value
+	template <std::size_t N>
+	bool IsFinite(Dual<N> const& x)
+	{
+		return std::isfinite(x.value) &&
+			std::all_of(x.gradient.begin(), x.gradient.end(), [](Real const& g) -> bool { return std::isfinite(g); });
+	};
+
+	template <std::size_t N>
+	Real Magnitude(Dual<N> const& x)
+	{
+		Real magnitude = std::abs(x.value);
+		for (Real const& g : x.gradient)
+			magnitude = std::max(magnitude, std::abs(g));
+		return magnitude;
+	};
+
+};
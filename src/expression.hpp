@@ -0,0 +1,579 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "./quadrature.hpp"
+
+// Integrands given as text, f(x) = "sqrt(x)+1/(3*sqrt(x))",
+// compiled to register bytecode and evaluated on blocks of abscissae
+namespace Quadrature
+{
+	// Grammar, with the usual precedence, '^' binds to the right and above unary minus:
+	//	expression = term { ('+' | '-') term }
+	//	term = unary { ('*' | '/') unary }
+	//	unary = ('+' | '-') unary | power
+	//	power = primary [ '^' unary ]
+	//	primary = number | 'x' | 'pi' | 'e' | function '(' expression [ ',' expression ] ')' | '(' expression ')'
+	// Functions: sin cos tan asin acos atan sinh cosh tanh exp log sqrt abs, and pow(a, b).
+	// Parentheses, arguments and signs nest at most max_nesting deep.
+	//
+	// Constant subexpressions are folded, and equal subexpressions computed once.
+	// The interpreter runs each instruction over a block of abscissae,
+	// so dispatch costs once per block rather than once per evaluation.
+	// Single abscissae run the same program one value at a time.
+	// Constants stay in the registers of a thread until it evaluates another expression.
+	class Expression
+	{
+	public:
+		enum class Op : uint8_t
+		{
+			constant, variable,
+			add, subtract, multiply, divide, power,
+			negate, sin, cos, tan, asin, acos, atan, sinh, cosh, tanh, exp, log, sqrt, abs
+		};
+
+		// Registers are filled for this many abscissae at a time
+		static constexpr std::size_t block{ 64 };
+
+		// Depth of nesting, deeper text is not valid rather than overflowing the stack
+		static constexpr std::size_t max_nesting{ 256 };
+
+		explicit Expression(std::string_view const text)
+			: text(text)
+			, identity(++count)
+		{
+			std::size_t const root = Parse();
+			Skip();
+			if (valid && (position != text.size()))
+				Fail("unexpected '" + std::string(1, text[position]) + "'");
+			if (valid)
+				Compile(root);
+			code.clear();
+			cse.clear();
+		};
+
+		bool Valid() const
+		{
+			return valid;
+		};
+
+		// Empty if valid, else the first error, with its position
+		std::string const& Error() const
+		{
+			return error;
+		};
+
+		// Instructions after folding and elimination
+		std::size_t Size() const
+		{
+			return program.size();
+		};
+
+		// True if the value depends on x, false for a constant as "pi/2"
+		bool Variable() const
+		{
+			return std::ranges::any_of(program, [](Step const& step) -> bool { return step.op == Op::variable; });
+		};
+
+		// Batch, y[i] = f(x[i]), NaN if the expression is not valid
+		void operator()(
+			std::span<Real const> x,
+			std::span<Real> y) const
+		{
+			if (!valid)
+			{
+				std::fill(y.begin(), y.end(), Real(NaN));
+				return;
+			}
+
+			std::vector<Real>& registers = Load(Batch(), block);
+
+			for (std::size_t first{ 0 };first < x.size();first += block)
+			{
+				std::size_t const m = std::min(block, x.size() - first);
+				for (Step const& step : program)
+				{
+					Real* const t = &registers[step.target * block];
+					Real const* const a = &registers[step.a * block];
+					Real const* const b = &registers[step.b * block];
+					auto map = [t, a, m](auto const& function)
+					{
+						for (std::size_t i{ 0 };i < m;++i)
+							t[i] = function(a[i]);
+					};
+					switch (step.op)
+					{
+					case Op::constant: break;
+					case Op::variable: std::copy_n(&x[first], m, t); break;
+					case Op::add: for (std::size_t i{ 0 };i < m;++i) t[i] = a[i] + b[i]; break;
+					case Op::subtract: for (std::size_t i{ 0 };i < m;++i) t[i] = a[i] - b[i]; break;
+					case Op::multiply: for (std::size_t i{ 0 };i < m;++i) t[i] = a[i] * b[i]; break;
+					case Op::divide: for (std::size_t i{ 0 };i < m;++i) t[i] = a[i] / b[i]; break;
+					case Op::power: for (std::size_t i{ 0 };i < m;++i) t[i] = std::pow(a[i], b[i]); break;
+					case Op::negate: for (std::size_t i{ 0 };i < m;++i) t[i] = -a[i]; break;
+					case Op::sin: map([](Real const& v) -> Real { return std::sin(v); }); break;
+					case Op::cos: map([](Real const& v) -> Real { return std::cos(v); }); break;
+					case Op::tan: map([](Real const& v) -> Real { return std::tan(v); }); break;
+					case Op::asin: map([](Real const& v) -> Real { return std::asin(v); }); break;
+					case Op::acos: map([](Real const& v) -> Real { return std::acos(v); }); break;
+					case Op::atan: map([](Real const& v) -> Real { return std::atan(v); }); break;
+					case Op::sinh: map([](Real const& v) -> Real { return std::sinh(v); }); break;
+					case Op::cosh: map([](Real const& v) -> Real { return std::cosh(v); }); break;
+					case Op::tanh: map([](Real const& v) -> Real { return std::tanh(v); }); break;
+					case Op::exp: map([](Real const& v) -> Real { return std::exp(v); }); break;
+					case Op::log: map([](Real const& v) -> Real { return std::log(v); }); break;
+					case Op::sqrt: map([](Real const& v) -> Real { return std::sqrt(v); }); break;
+					case Op::abs: map([](Real const& v) -> Real { return std::abs(v); }); break;
+					};
+				};
+				std::copy_n(&registers[result * block], m, &y[first]);
+			};
+		};
+
+		// Single abscissa, as the batch
+		Real operator()(Real const& x) const
+		{
+			if (!valid)
+				return NaN;
+
+			Real* const r = Load(Scalar(), 1).data();
+			for (Step const& step : program)
+			{
+				switch (step.op)
+				{
+				case Op::constant: break;
+				case Op::variable: r[step.target] = x; break;
+				default: r[step.target] = Apply(step.op, r[step.a], r[step.b]); break;
+				};
+			};
+			return r[result];
+		};
+
+	private:
+		// Scratch registers of a thread, with the constants of the expression last loaded
+		struct Registers
+		{
+			std::vector<Real> values;
+			uint64_t loaded{ 0 }; // Identity of the expression
+		};
+
+		static Registers& Batch()
+		{
+			thread_local Registers registers;
+			return registers;
+		};
+
+		static Registers& Scalar()
+		{
+			thread_local Registers registers;
+			return registers;
+		};
+
+		static inline std::atomic<uint64_t> count{ 0 };
+
+		// Registers of 'width' values each, constants written if another expression used them last
+		std::vector<Real>& Load(
+			Registers& registers,
+			std::size_t const width) const
+		{
+			if (registers.loaded != identity)
+			{
+				registers.values.resize(slots * width);
+				for (Step const& step : program)
+					if (step.op == Op::constant)
+						std::fill_n(&registers.values[step.target * width], width, step.constant);
+				registers.loaded = identity;
+			}
+			return registers.values;
+		};
+
+		// Single assignment form, while compiling
+		struct Instruction
+		{
+			Op op;
+			std::size_t a{ 0 };
+			std::size_t b{ 0 };
+			Real constant{ 0 };
+		};
+
+		// Register form, after allocation
+		struct Step
+		{
+			Op op;
+			uint32_t target;
+			uint32_t a;
+			uint32_t b;
+			Real constant;
+		};
+
+		std::string text;
+		std::size_t position{ 0 };
+		std::size_t depth{ 0 };
+		bool valid{ true };
+		std::string error;
+		uint64_t identity; // Of the program, shared by copies
+
+		std::vector<Instruction> code;
+		std::map<std::tuple<Op, std::size_t, std::size_t, std::array<unsigned char, sizeof(Real)>>, std::size_t> cse;
+
+		std::vector<Step> program;
+		std::size_t slots{ 0 };
+		uint32_t result{ 0 };
+
+		// Number of operands
+		static uint8_t Arity(Op const op)
+		{
+			return (op < Op::add) ? 0 : (op <= Op::power) ? 2 : 1;
+		};
+
+		static Real Apply(
+			Op const op,
+			Real const& a,
+			Real const& b)
+		{
+			switch (op)
+			{
+			case Op::add: return a + b;
+			case Op::subtract: return a - b;
+			case Op::multiply: return a * b;
+			case Op::divide: return a / b;
+			case Op::power: return std::pow(a, b);
+			case Op::negate: return -a;
+			case Op::sin: return std::sin(a);
+			case Op::cos: return std::cos(a);
+			case Op::tan: return std::tan(a);
+			case Op::asin: return std::asin(a);
+			case Op::acos: return std::acos(a);
+			case Op::atan: return std::atan(a);
+			case Op::sinh: return std::sinh(a);
+			case Op::cosh: return std::cosh(a);
+			case Op::tanh: return std::tanh(a);
+			case Op::exp: return std::exp(a);
+			case Op::log: return std::log(a);
+			case Op::sqrt: return std::sqrt(a);
+			case Op::abs: return std::abs(a);
+			default: return NaN;
+			};
+		};
+
+		void Fail(std::string const& message)
+		{
+			if (valid)
+				error = message + " at " + std::to_string(position);
+			valid = false;
+		};
+
+		// Folds constants, and returns an existing instruction for a repeated one
+		std::size_t Emit(
+			Op const op,
+			std::size_t a = 0,
+			std::size_t b = 0,
+			Real const& constant = 0)
+		{
+			if (!valid)
+				return 0;
+
+			if ((Arity(op) == 1) && (code[a].op == Op::constant))
+				return Emit(Op::constant, 0, 0, Apply(op, code[a].constant, 0));
+			if ((Arity(op) == 2) && (code[a].op == Op::constant) && (code[b].op == Op::constant))
+				return Emit(Op::constant, 0, 0, Apply(op, code[a].constant, code[b].constant));
+			if (((op == Op::add) || (op == Op::multiply)) && (b < a))
+				std::swap(a, b);
+
+			std::array<unsigned char, sizeof(Real)> bits{};
+			if (op == Op::constant)
+				std::memcpy(bits.data(), &constant, sizeof(Real));
+			auto const [entry, inserted] = cse.try_emplace({ op, a, b, bits }, code.size());
+			if (inserted)
+				code.push_back({ op, a, b, constant });
+			return entry->second;
+		};
+
+		void Skip()
+		{
+			while ((position < text.size()) && std::isspace(static_cast<unsigned char>(text[position])))
+				++position;
+		};
+
+		bool Accept(char const c)
+		{
+			Skip();
+			if ((position < text.size()) && (text[position] == c))
+			{
+				++position;
+				return true;
+			}
+			return false;
+		};
+
+		std::size_t Parse()
+		{
+			std::size_t left = Term();
+			for (;;)
+			{
+				if (Accept('+'))
+					left = Emit(Op::add, left, Term());
+				else if (Accept('-'))
+					left = Emit(Op::subtract, left, Term());
+				else
+					return left;
+			};
+		};
+
+		std::size_t Term()
+		{
+			std::size_t left = Negation();
+			for (;;)
+			{
+				if (Accept('*'))
+					left = Emit(Op::multiply, left, Negation());
+				else if (Accept('/'))
+					left = Emit(Op::divide, left, Negation());
+				else
+					return left;
+			};
+		};
+
+		std::size_t Negation()
+		{
+			if (depth >= max_nesting)
+			{
+				Fail("nested too deep");
+				return 0;
+			}
+			++depth;
+			std::size_t const node = Unary();
+			--depth;
+			return node;
+		};
+
+		std::size_t Unary()
+		{
+			if (Accept('-'))
+				return Emit(Op::negate, Negation());
+			if (Accept('+'))
+				return Negation();
+			std::size_t const base = Primary();
+			if (Accept('^'))
+				return Emit(Op::power, base, Negation());
+			return base;
+		};
+
+		std::size_t Primary()
+		{
+			Skip();
+			if (!valid)
+				return 0;
+			if (position >= text.size())
+			{
+				Fail("unexpected end");
+				return 0;
+			}
+
+			if (Accept('('))
+			{
+				std::size_t const inner = Parse();
+				if (!Accept(')'))
+					Fail("expected ')'");
+				return inner;
+			}
+
+			char const c = text[position];
+			if (std::isdigit(static_cast<unsigned char>(c)) || (c == '.'))
+				return Number();
+
+			if (!std::isalpha(static_cast<unsigned char>(c)))
+			{
+				Fail("unexpected '" + std::string(1, c) + "'");
+				return 0;
+			}
+
+			std::size_t const start = position;
+			while ((position < text.size()) && std::isalnum(static_cast<unsigned char>(text[position])))
+				++position;
+			std::string const name = text.substr(start, position - start);
+
+			if (name == "x")
+				return Emit(Op::variable);
+			if (name == "pi")
+				return Emit(Op::constant, 0, 0, pi);
+			if (name == "e")
+				return Emit(Op::constant, 0, 0, std::exp(Real(1)));
+
+			static std::map<std::string, Op> const functions{
+				{ "sin", Op::sin }, { "cos", Op::cos }, { "tan", Op::tan },
+				{ "asin", Op::asin }, { "acos", Op::acos }, { "atan", Op::atan },
+				{ "sinh", Op::sinh }, { "cosh", Op::cosh }, { "tanh", Op::tanh },
+				{ "exp", Op::exp }, { "log", Op::log }, { "sqrt", Op::sqrt }, { "abs", Op::abs },
+				{ "pow", Op::power } };
+			auto const function = functions.find(name);
+			if (function == functions.end())
+			{
+				position = start;
+				Fail("unknown name '" + name + "'");
+				return 0;
+			}
+			if (!Accept('('))
+			{
+				Fail("expected '(' after " + name);
+				return 0;
+			}
+			std::size_t const a = Parse();
+			std::size_t b{ 0 };
+			if (function->second == Op::power)
+			{
+				if (!Accept(','))
+					Fail("expected ','");
+				b = Parse();
+			}
+			if (!Accept(')'))
+				Fail("expected ')'");
+			return Emit(function->second, a, b);
+		};
+
+		// Decimal number, the digits are accumulated in Real, so constants keep its precision
+		// The literal is scanned here, and read by std::from_chars, so it is rounded
+		// correctly whatever the number of digits. Out of range, above the largest
+		// or below the smallest normal number, it is infinite or zero
+		std::size_t Number()
+		{
+			std::size_t const first = position;
+			int magnitude{ 0 }; // Decimal exponent of the first significant digit, plus one
+			bool digits{ false };
+			bool significant{ false };
+			while ((position < text.size()) && std::isdigit(static_cast<unsigned char>(text[position])))
+			{
+				significant |= text[position++] != '0';
+				magnitude += significant;
+				digits = true;
+			};
+			if ((position < text.size()) && (text[position] == '.'))
+			{
+				++position;
+				while ((position < text.size()) && std::isdigit(static_cast<unsigned char>(text[position])))
+				{
+					magnitude -= !significant && (text[position] == '0');
+					significant |= text[position++] != '0';
+					digits = true;
+				};
+			}
+			if (!digits)
+			{
+				Fail("expected digits");
+				return 0;
+			}
+			if ((position < text.size()) && ((text[position] == 'e') || (text[position] == 'E')))
+			{
+				std::size_t const mark = position++;
+				int sign{ 1 };
+				if ((position < text.size()) && ((text[position] == '+') || (text[position] == '-')))
+					sign = (text[position++] == '-') ? -1 : 1;
+				if ((position < text.size()) && std::isdigit(static_cast<unsigned char>(text[position])))
+				{
+					int power{ 0 };
+					while ((position < text.size()) && std::isdigit(static_cast<unsigned char>(text[position])))
+						power = std::min(power * 10 + (text[position++] - '0'), 100000);
+					magnitude += sign * power;
+				}
+				else
+					position = mark; // Not an exponent, the 'e' is left to the caller
+			}
+
+			// A zero mantissa is zero, whatever the exponent
+			Real value{ 0 };
+			if (significant && (std::from_chars(text.data() + first, text.data() + position, value).ec != std::errc()))
+				value = (magnitude > 0) ? std::numeric_limits<Real>::infinity() : Real(0);
+			return Emit(Op::constant, 0, 0, value);
+		};
+
+		// Drops unused instructions, and assigns registers:
+		// constants and x get their own, others reuse registers no longer needed
+		void Compile(std::size_t const root)
+		{
+			std::vector<bool> live(code.size(), false);
+			live[root] = true;
+			for (std::size_t i{ root + 1 };i-- > 0;)
+			{
+				if (!live[i])
+					continue;
+				Instruction const& instruction = code[i];
+				if (Arity(instruction.op) >= 1)
+					live[instruction.a] = true;
+				if (Arity(instruction.op) == 2)
+					live[instruction.b] = true;
+			};
+
+			std::vector<std::size_t> last(code.size(), 0);
+			for (std::size_t i{ 0 };i <= root;++i)
+			{
+				if (!live[i])
+					continue;
+				if (Arity(code[i].op) >= 1)
+					last[code[i].a] = i;
+				if (Arity(code[i].op) == 2)
+					last[code[i].b] = i;
+			};
+
+			std::vector<uint32_t> slot(code.size(), 0);
+			std::vector<uint32_t> free;
+			for (std::size_t i{ 0 };i <= root;++i)
+			{
+				if (!live[i])
+					continue;
+				Instruction const& instruction = code[i];
+				uint8_t const arity = Arity(instruction.op);
+
+				// Operands used for the last time, their registers may hold the result
+				for (std::size_t const operand : { instruction.a, instruction.b })
+				{
+					if ((operand == instruction.b) && (arity < 2))
+						break;
+					if ((arity > 0) && (last[operand] == i) && (Arity(code[operand].op) > 0) &&
+						(std::find(free.begin(), free.end(), slot[operand]) == free.end()))
+						free.push_back(slot[operand]);
+				};
+
+				if (arity && !free.empty())
+				{
+					slot[i] = free.back();
+					free.pop_back();
+				}
+				else
+					slot[i] = static_cast<uint32_t>(slots++);
+
+				program.push_back({ instruction.op, slot[i], slot[instruction.a], slot[instruction.b], instruction.constant });
+			};
+			result = slot[root];
+		};
+	};
+
+};
@@ -0,0 +1,152 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <concepts>
+
+#include "./quadrature.hpp"
+#include "./panel.hpp"
+
+namespace Quadrature
+{
+	// Global adaptive Lobatto, with the rule of LobattoResult.
+	// The panel with the largest error is split at its nodes into six,
+	// until the sum of all errors is below epsilon (not epsilon per panel),
+	// or the next split would exceed 'max_evaluations'.
+	//
+	// Panels live in the arena of the calling thread, no memory is allocated
+	// once the arena has grown to the panels of an earlier call.
+	template <typename Function, typename Value = ValueOf<Function>>
+		requires std::invocable<Function const&, Real>
+	Result<Value> LobattoGlobal(
+		Function const& function,
+		Real a,
+		Real b,
+		Real const& a_epsilon = 1e-10,
+		std::size_t const max_evaluations = 1'000'000)
+	{
+		Real static const node_lobatto = std::sqrt(Real(1) / Real(5));
+		Real static const node_kronrod = std::sqrt(Real(2) / Real(3));
+
+		if (b < a)
+			std::swap(a, b);
+
+		Real const epsilon = std::max(a_epsilon, numeric_epsilon);
+
+		Result<Value> result;
+		PanelLease<Value, 5> arena;
+
+		// Abscissae of a panel, endpoints included
+		auto abscissae = [&arena](std::size_t const& panel) -> std::array<Real, 7>
+		{
+			Real const start = arena->a[panel];
+			Real const end = arena->b[panel];
+			Real const h = (end - start) / 2;
+			Real const middle = (start + end) / 2;
+			return { start, middle - node_kronrod * h, middle - node_lobatto * h, middle,
+				middle + node_lobatto * h, middle + node_kronrod * h, end };
+		};
+
+		// Rule over a panel, false if the integrand is not finite
+		auto evaluate = [&](std::size_t const& panel) -> bool
+		{
+			std::array<Real, 7> const x = abscissae(panel);
+			Value* const y = arena->Inside(panel);
+			for (std::size_t i{ 0 };i < 5;++i)
+				y[i] = function(x[i + 1]);
+			result.evaluations += 5;
+
+			Value const& start = arena->fa[panel];
+			Value const& end = arena->fb[panel];
+			Real const h = (x[6] - x[0]) / 2;
+
+			Value const area_kronrod = (h / 1470) *
+				((start + end) * Real(77) + (y[0] + y[4]) * Real(432) + (y[1] + y[3]) * Real(625) + y[2] * Real(672));
+			Value const area_lobatto = (h / 6) * (start + end + (y[1] + y[3]) * Real(5));
+
+			arena->estimate[panel] = area_kronrod;
+			arena->error[panel] = Magnitude(area_kronrod - area_lobatto);
+			return IsFinite(area_kronrod);
+		};
+
+		Value const f_a = function(a);
+		Value const f_b = function(b);
+		result.evaluations = 2;
+
+		std::size_t const root = arena->Allocate(a, b, f_a, f_b);
+		if (!IsFinite(f_a) || !IsFinite(f_b) || !evaluate(root))
+		{
+			result.value = Value(NaN);
+			result.status = Status::not_finite;
+			return result;
+		}
+		arena->queue.Push(root);
+		Real total_error = arena->error[root];
+
+		while (total_error >= epsilon)
+		{
+			if (result.evaluations + 30 > max_evaluations)
+			{
+				result.status = Status::limit;
+				break;
+			}
+
+			std::size_t const panel = arena->queue.Pop();
+			if ((arena->b[panel] - arena->a[panel]) / 2 < numeric_interval)
+			{
+				arena->queue.Push(panel);
+				result.status = Status::limit;
+				break;
+			}
+			total_error -= arena->error[panel];
+
+			// Copied, the children may take the slot of the panel
+			std::array<Real, 7> const x = abscissae(panel);
+			std::array<Value, 7> y;
+			y[0] = arena->fa[panel];
+			std::copy(arena->Inside(panel), arena->Inside(panel) + 5, y.begin() + 1);
+			y[6] = arena->fb[panel];
+			arena->Release(panel);
+
+			for (std::size_t i{ 0 };i < 6;++i)
+			{
+				std::size_t const child = arena->Allocate(x[i], x[i + 1], y[i], y[i + 1]);
+				if (!evaluate(child))
+				{
+					result.value = Value(NaN);
+					result.status = Status::not_finite;
+					return result;
+				}
+				arena->queue.Push(child);
+				total_error += arena->error[child];
+			};
+		};
+
+		// Sum afresh, rather than from the running total
+		result.value = Value(0);
+		for (std::size_t const& panel : arena->queue.Indices())
+		{
+			result.value += arena->estimate[panel];
+			result.error += arena->error[panel];
+		};
+		return result;
+	};
+
+};
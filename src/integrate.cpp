@@ -0,0 +1,208 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+// Batch integrator, one job per line of a file (or stdin):
+//
+//	engine[:depth] a b epsilon expression
+//
+// with engine lobatto, batch (Lobatto on batches of abscissae) or simpson, for example
+//
+//	lobatto 4 9 1e-12 sqrt(x)+1/(3*sqrt(x))
+//	simpson:12 0 pi 1e-10 sin(x)
+//
+// Bounds and epsilon may be constant expressions, as pi/2, a line using x in them is invalid.
+// Blank lines and lines starting with '#' are skipped. Results are written in input order,
+// as CSV 'line,value,error,evaluations,status', or with --binary as replies of protocol.hpp
+// (the id is the line number). Jobs are read, integrated and written a chunk at a time,
+// so the memory used does not depend on the number of jobs.
+//
+//	./bin/integrate [--binary] [--threads N] [file]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./expression.hpp"
+#include "./output.hpp"
+#include "./pool.hpp"
+#include "./protocol.hpp"
+#include "./reverse.hpp"
+
+namespace
+{
+	struct Job
+	{
+		uint64_t line{ 0 };
+		std::string text;
+		Quadrature::Result<Real> result;
+	};
+
+	// Bounds may be expressions too, as "pi/2", but not of x
+	bool Bound(
+		std::string const& text,
+		Real& value)
+	{
+		Quadrature::Expression const expression(text);
+		value = expression(Real(0));
+		return expression.Valid() && !expression.Variable() && std::isfinite(value);
+	};
+
+	Quadrature::Result<Real> Run(std::string const& text)
+	{
+		Quadrature::Result<Real> result;
+		result.value = NaN;
+		result.status = Quadrature::Status::invalid;
+
+		std::istringstream stream(text);
+		std::string engine, a_text, b_text, epsilon_text, formula;
+		stream >> engine >> a_text >> b_text >> epsilon_text;
+		std::getline(stream >> std::ws, formula);
+
+		uint8_t depth{ 0 };
+		if (std::size_t const colon = engine.find(':');colon != std::string::npos)
+		{
+			depth = static_cast<uint8_t>(std::clamp(std::atoi(engine.c_str() + colon + 1), 0, 255));
+			engine.resize(colon);
+		}
+
+		Real a{ 0 }, b{ 0 }, epsilon{ 0 };
+		if (!Bound(a_text, a) || !Bound(b_text, b) || !Bound(epsilon_text, epsilon))
+			return result;
+
+		Quadrature::Expression const function(formula);
+		if (!function.Valid())
+			return result;
+
+		if (engine == "lobatto")
+			return Quadrature::LobattoResult(function, a, b, epsilon, depth ? depth : 2);
+		if (engine == "batch")
+			return Quadrature::LobattoBatch(function, a, b, epsilon, depth ? depth : 2);
+		if (engine == "simpson")
+		{
+			std::size_t evaluations{ 0 };
+			auto counted = [&function, &evaluations](Real const& x) -> Real
+			{
+				++evaluations;
+				return function(x);
+			};
+			result.value = Quadrature::Simpson(counted, a, b, epsilon, depth ? depth : 8);
+			// Simpson does not estimate its error
+			result.error = NaN;
+			result.evaluations = evaluations;
+			result.status = std::isfinite(result.value) ? Quadrature::Status::converged : Quadrature::Status::not_finite;
+		}
+		return result;
+	};
+
+	void Write(
+		std::ostream& out,
+		Job const& job,
+		std::vector<char>& buffer)
+	{
+		buffer.clear();
+		Quadrature::Protocol::Encode({ job.line, double(job.result.value), double(job.result.error),
+			job.result.evaluations, static_cast<uint8_t>(job.result.status) }, buffer);
+		out.write(buffer.data(), buffer.size());
+	};
+};
+
+int main(int argc, char* argv[])
+{
+	bool binary{ false };
+	unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::string path;
+	for (int i{ 1 };i < argc;++i)
+	{
+		std::string const argument = argv[i];
+		if (argument == "--binary")
+			binary = true;
+		else if ((argument == "--threads") && (i + 1 < argc))
+			threads = std::max(std::atoi(argv[++i]), 1);
+		else
+			path = argument;
+	};
+	Quadrature::ThreadPool::Configure(threads);
+
+	std::ifstream file;
+	if (!path.empty() && (path != "-"))
+	{
+		file.open(path);
+		if (!file)
+		{
+			std::cerr << "integrate: cannot open " << path << "\n";
+			return 1;
+		}
+	}
+	std::istream& in = file.is_open() ? static_cast<std::istream&>(file) : std::cin;
+	std::ostream& out = std::cout;
+	std::ios::sync_with_stdio(false);
+
+	std::optional<Quadrature::CsvWriter> csv;
+	if (!binary)
+		csv.emplace(out, "line");
+
+	// Jobs read, integrated and written at a time
+	std::size_t const chunk{ 4096 };
+	std::vector<Job> jobs;
+	jobs.reserve(chunk);
+	std::vector<char> buffer;
+
+	uint64_t line{ 0 };
+	std::string text;
+	bool more{ true };
+	while (more)
+	{
+		jobs.clear();
+		while ((jobs.size() < chunk) && (more = static_cast<bool>(std::getline(in, text))))
+		{
+			++line;
+			std::size_t const first = text.find_first_not_of(" \t\r");
+			if ((first == std::string::npos) || (text[first] == '#'))
+				continue;
+			jobs.push_back({ line, text, {} });
+		};
+
+		unsigned const participants = std::min<std::size_t>(threads, jobs.size());
+		Quadrature::WorkIndices indices(jobs.size(), participants);
+		Quadrature::ThreadPool::Instance().Run(participants, [&]()
+			{
+				for (std::size_t i = indices.Next();i < jobs.size();i = indices.Next())
+					jobs[i].result = Run(jobs[i].text);
+			});
+
+		for (Job const& job : jobs)
+		{
+			if (job.result.status == Quadrature::Status::invalid)
+				std::cerr << "integrate: line " << job.line << ": invalid job\n";
+			if (csv)
+				csv->Row(job.line, job.result);
+			else
+				Write(out, job, buffer);
+		};
+	};
+	csv.reset();
+	out.flush();
+	return 0;
+};
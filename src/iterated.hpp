@@ -0,0 +1,188 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./pool.hpp"
+
+// Iterated integration over a region bounded by functions,
+// from 'a' to 'b' in x, and from lower(x) to upper(x) in y
+namespace Quadrature
+{
+	// Outer integral with the Lobatto rule, refined one level at a time,
+	// inner integrals with LobattoResult.
+	//
+	// The error budget is split between the two. Each inner integral gets
+	// epsilon / (2 (b - a)), so the inner errors weighted by the outer rule stay within half.
+	// Inner results are cached by abscissa, and those needed by a level are run in parallel.
+	//
+	// The error is the outer |Kronrod - Lobatto| of the accepted intervals,
+	// plus the inner errors weighted by the Kronrod weights.
+	template <typename Function, typename Lower, typename Upper>
+		requires std::invocable<Function const&, Real, Real>
+			&& std::invocable<Lower const&, Real> && std::invocable<Upper const&, Real>
+	Result<Real> Iterated(
+		Function const& function,
+		Real a,
+		Real b,
+		Lower const& lower,
+		Upper const& upper,
+		Real const& a_epsilon = 1e-10,
+		uint8_t const& a_max_depth = 2,
+		unsigned const a_threads = std::thread::hardware_concurrency())
+	{
+		Real static const node_lobatto = std::sqrt(Real(1) / Real(5));
+		Real static const node_kronrod = std::sqrt(Real(2) / Real(3));
+
+		if (b < a)
+			std::swap(a, b);
+
+		uint8_t const max_depth = std::min(a_max_depth, static_cast<uint8_t>(8));
+		unsigned const threads = std::max(a_threads, 1u);
+
+		Real const epsilon = std::max(a_epsilon, numeric_epsilon);
+		Real const outer_epsilon = epsilon / 2;
+		Real const inner_epsilon = std::max(epsilon / (2 * std::max(b - a, numeric_interval)), numeric_epsilon);
+
+		Result<Real> result;
+
+		// Inner integral by outer abscissa
+		std::map<Real, Result<Real>> cache;
+
+		// Run the inner integrals not yet cached, in parallel
+		auto inner = [&](std::vector<Real> abscissae)
+		{
+			std::erase_if(abscissae, [&cache](Real const& x) -> bool { return cache.contains(x); });
+			std::sort(abscissae.begin(), abscissae.end());
+			abscissae.erase(std::unique(abscissae.begin(), abscissae.end()), abscissae.end());
+
+			std::vector<Result<Real>> integrals(abscissae.size());
+			unsigned const participants = std::min<std::size_t>(threads, abscissae.size());
+			WorkIndices indices(abscissae.size(), participants);
+			auto worker = [&]()
+			{
+				for (std::size_t i = indices.Next();i < abscissae.size();i = indices.Next())
+				{
+					Real const x = abscissae[i];
+					integrals[i] = LobattoResult(
+						[&function, &x](Real const& y) -> Real { return function(x, y); },
+						lower(x), upper(x), inner_epsilon, max_depth);
+				};
+			};
+
+			ThreadPool::Instance().Run(participants, worker);
+
+			for (std::size_t i{ 0 };i < abscissae.size();++i)
+			{
+				result.evaluations += integrals[i].evaluations;
+				cache.emplace(abscissae[i], integrals[i]);
+			};
+		};
+
+		struct Panel
+		{
+			Real start;
+			Real end;
+			uint8_t depth;
+		};
+
+		std::vector<Panel> level{ { a, b, 0 } };
+		std::vector<Panel> next;
+		std::vector<Real> abscissae{ a, b };
+
+		while (!level.empty())
+		{
+			for (Panel const& panel : level)
+			{
+				Real const h = (panel.end - panel.start) / 2;
+				Real const middle = (panel.start + panel.end) / 2;
+				for (Real const& offset : { -node_kronrod, -node_lobatto, Real(0), node_lobatto, node_kronrod })
+					abscissae.push_back(middle + offset * h);
+			};
+			inner(abscissae);
+			abscissae.clear();
+
+			next.clear();
+			for (Panel const& panel : level)
+			{
+				Real const h = (panel.end - panel.start) / 2;
+				Real const middle = (panel.start + panel.end) / 2;
+
+				std::array<Real, 7> const x{ panel.start,
+					middle - node_kronrod * h, middle - node_lobatto * h, middle,
+					middle + node_lobatto * h, middle + node_kronrod * h, panel.end };
+
+				std::array<Result<Real> const*, 7> y;
+				for (std::size_t i{ 0 };i < 7;++i)
+					y[i] = &cache.find(x[i])->second;
+
+				// Seven point area approximation
+				Real const area_kronrod = (h / 1470) *
+					((y[0]->value + y[6]->value) * 77 + (y[1]->value + y[5]->value) * 432 +
+						(y[2]->value + y[4]->value) * 625 + y[3]->value * 672);
+
+				if (!std::isfinite(area_kronrod))
+				{
+					result.value = NaN;
+					result.status = Status::not_finite;
+					return result;
+				}
+
+				// Four point area approximation
+				Real const area_lobatto = (h / 6) * (y[0]->value + y[6]->value + (y[2]->value + y[4]->value) * 5);
+
+				Real const error = std::abs(area_kronrod - area_lobatto);
+
+				bool const limit = (std::abs(h) < numeric_interval) || (panel.depth + 1 > max_depth);
+				if (limit || (error < outer_epsilon))
+				{
+					if (limit && (error >= outer_epsilon))
+						result.status = Status::limit;
+
+					// Inner errors, weighted as their values
+					Real const inner_error = (std::abs(h) / 1470) *
+						((y[0]->error + y[6]->error) * 77 + (y[1]->error + y[5]->error) * 432 +
+							(y[2]->error + y[4]->error) * 625 + y[3]->error * 672);
+					for (Result<Real> const* r : y)
+						if (r->status == Status::limit)
+							result.status = Status::limit;
+
+					result.value += area_kronrod;
+					result.error += error + inner_error;
+					continue;
+				}
+
+				uint8_t const depth = panel.depth + 1;
+				for (std::size_t i{ 0 };i < 6;++i)
+					next.push_back({ x[i], x[i + 1], depth });
+			};
+			std::swap(level, next);
+		};
+
+		return result;
+	};
+
+};
@@ -3,12 +3,16 @@
 #include <stdfloat>
 #endif
 
+#include <array>
 #include <cmath>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 
 #include "./quadrature.hpp"
+#include "./bounded.hpp"
+#include "./cubature.hpp"
+#include "./expression.hpp"
 
 Real Function(Real const& x) {
 	return std::sin(x);
@@ -28,6 +32,7 @@ int main(int argc, char* argv[])
 	std::cout << "Exact value: " << Real(-std::cos(pi)) - Real(-std::cos(0)) << "\n";
 	std::cout << "Simpson:     " << Quadrature::Simpson(Function, 0, pi) << "\n";
 	std::cout << "Lobatto:     " << Quadrature::Lobatto(lambda, 0, pi) << "\n";
+	std::cout << "Bounded:     " << Quadrature::Bounded::Lobatto<2>(lambda, 0, pi).value << "\n";
 
 	auto func_poly = [](Real const& x) -> Real
 	{
@@ -61,6 +66,7 @@ int main(int argc, char* argv[])
 	std::cout << "Exact value: " << Real(40) / Real(3) << "\n";
 	std::cout << "Simpson:     " << Quadrature::Simpson(func_sqrt, 4, 9) << "\n";
 	std::cout << "Lobatto:     " << Quadrature::Lobatto(func_sqrt, 4, 9) << "\n";
+	std::cout << "Expression:  " << Quadrature::Lobatto(Quadrature::Expression("sqrt(x)+1/(3*sqrt(x))"), 4, 9) << "\n";
 
 	std::cout << "\nf(x)=x^i, x=[0;1]\n";
 	// x^(1+i) / (1+i)
@@ -73,4 +79,15 @@ int main(int argc, char* argv[])
 		std::cout << "x^" << i + 0 << ": " << Quadrature::Lobatto(func_capture, 0, 1) << "\n";
 	};
 
+	std::cout << "\nf(x,y)=sin(x)sin(y), x,y=[0;pi]\n";
+	auto func_plane = [](std::span<Real const> x) -> Real
+	{
+		return std::sin(x[0]) * std::sin(x[1]);
+	};
+	std::array<Real, 2> const plane_a{ 0, 0 };
+	std::array<Real, 2> const plane_b{ pi, pi };
+	auto const plane = Quadrature::GenzMalik(func_plane, plane_a, plane_b);
+	std::cout << "Exact value: " << Real(4) << "\n";
+	std::cout << "Genz-Malik:  " << plane.value << " (" << plane.evaluations << " evaluations)\n";
+
 };
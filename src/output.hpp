@@ -0,0 +1,127 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+#include "./quadrature.hpp"
+#include "./plugin.h"
+
+// Results written in bulk as text,
+// through a buffer and without allocating per value
+namespace Quadrature
+{
+	// Double-double as RealToChars, through the sum of both parts in Real.
+	// If Real is binary128 the text reads back to the same double-double,
+	// unless 'lo' has bits beyond the 113 of binary128.
+	std::to_chars_result DoubleDoubleToChars(
+		char* const first,
+		char* const last,
+		quadrature_dd const& value,
+		uint8_t const& decimals = 0)
+	{
+		return RealToChars(first, last, Real(value.hi) + Real(value.lo), decimals);
+	};
+
+	// Rows 'id,value,error,evaluations,status', with values in shortest round-trip form
+	class CsvWriter
+	{
+	public:
+		CsvWriter(
+			std::ostream& out,
+			std::string_view const id = "index")
+			: out(out)
+		{
+			Append(id);
+			Append(",value,error,evaluations,status\n");
+		};
+
+		CsvWriter(CsvWriter const&) = delete;
+		CsvWriter& operator=(CsvWriter const&) = delete;
+
+		~CsvWriter()
+		{
+			Flush();
+		};
+
+		void Row(
+			uint64_t const id,
+			Result<Real> const& result)
+		{
+			if (buffer.size() - used < row_size)
+				Flush();
+
+			char* const last = buffer.data() + buffer.size();
+			char* next = std::to_chars(buffer.data() + used, last, id).ptr;
+			*next++ = ',';
+			next = RealToChars(next, last, result.value).ptr;
+			*next++ = ',';
+			next = RealToChars(next, last, result.error).ptr;
+			*next++ = ',';
+			next = std::to_chars(next, last, result.evaluations).ptr;
+			*next++ = ',';
+			next = std::to_chars(next, last, static_cast<int>(result.status)).ptr;
+			*next++ = '\n';
+			used = next - buffer.data();
+		};
+
+		void Flush()
+		{
+			out.write(buffer.data(), used);
+			used = 0;
+		};
+
+	private:
+		// Longest row: two integers of 20 digits, two values of at most 64 characters and the status
+		static constexpr std::size_t row_size{ 20 + 64 + 64 + 20 + 3 + 5 };
+
+		void Append(std::string_view const text)
+		{
+			if (buffer.size() - used < text.size())
+			{
+				Flush();
+				out.write(text.data(), text.size());
+				return;
+			}
+			std::memcpy(buffer.data() + used, text.data(), text.size());
+			used += text.size();
+		};
+
+		std::ostream& out;
+		std::array<char, 1 << 16> buffer;
+		std::size_t used{ 0 };
+	};
+
+	// Results as CSV, numbered from 'first'
+	void WriteCsv(
+		std::ostream& out,
+		std::span<Result<Real> const> const results,
+		uint64_t const first = 0)
+	{
+		CsvWriter writer(out);
+		for (std::size_t i{ 0 };i < results.size();++i)
+			writer.Row(first + i, results[i]);
+	};
+
+};
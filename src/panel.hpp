@@ -0,0 +1,249 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <span>
+#include <vector>
+
+#include "./quadrature.hpp"
+
+// Storage of the panels (intervals) of global adaptive engines,
+// indices into arrays rather than a node allocated per split
+namespace Quadrature
+{
+	// Max heap of indices, ordered by priority[index].
+	// The priorities of queued indices must not change.
+	class PanelQueue
+	{
+	public:
+		explicit PanelQueue(std::vector<Real> const& priority)
+			: priority(priority)
+		{};
+
+		PanelQueue(PanelQueue const&) = delete;
+		PanelQueue& operator=(PanelQueue const&) = delete;
+
+		bool Empty() const
+		{
+			return heap.empty();
+		};
+
+		std::size_t Size() const
+		{
+			return heap.size();
+		};
+
+		void Push(std::size_t const index)
+		{
+			heap.push_back(index);
+			std::push_heap(heap.begin(), heap.end(), Order{ priority });
+		};
+
+		// Index of the largest priority, removed from the queue
+		std::size_t Pop()
+		{
+			std::pop_heap(heap.begin(), heap.end(), Order{ priority });
+			std::size_t const index = heap.back();
+			heap.pop_back();
+			return index;
+		};
+
+		// Queued indices, in heap order
+		std::span<std::size_t const> Indices() const
+		{
+			return heap;
+		};
+
+		// Keeps the memory, for the next call
+		void Clear()
+		{
+			heap.clear();
+		};
+
+	private:
+		struct Order
+		{
+			std::vector<Real> const& priority;
+
+			bool operator()(
+				std::size_t const& lhs,
+				std::size_t const& rhs) const
+			{
+				return priority[lhs] < priority[rhs];
+			};
+		};
+
+		std::vector<Real> const& priority;
+		std::vector<std::size_t> heap;
+	};
+
+	// Panels as structure of arrays, slots of released panels are reused.
+	// 'Interior' values of f inside each panel are kept for the rule of the engine.
+	// Queue orders the panels by error.
+	template <typename Value = Real, std::size_t Interior = 0>
+	class PanelArena
+	{
+	public:
+		std::vector<Real> a;
+		std::vector<Real> b;
+		std::vector<Value> fa; // f(a)
+		std::vector<Value> fb; // f(b)
+		std::vector<Value> estimate;
+		std::vector<Real> error;
+		std::vector<Value> interior; // 'Interior' per panel
+
+		PanelQueue queue{ error };
+
+		PanelArena() {};
+		PanelArena(PanelArena const&) = delete;
+		PanelArena& operator=(PanelArena const&) = delete;
+
+		// Slot of a new panel, estimate, error and interior values are left to the caller
+		std::size_t Allocate(
+			Real const& start,
+			Real const& end,
+			Value const& f_start,
+			Value const& f_end)
+		{
+			std::size_t index = a.size();
+			if (free.empty())
+			{
+				a.push_back(start);
+				b.push_back(end);
+				fa.push_back(f_start);
+				fb.push_back(f_end);
+				estimate.push_back(Value(0));
+				error.push_back(0);
+				interior.resize(interior.size() + Interior);
+			}
+			else
+			{
+				index = free.back();
+				free.pop_back();
+				a[index] = start;
+				b[index] = end;
+				fa[index] = f_start;
+				fb[index] = f_end;
+			}
+			return index;
+		};
+
+		Value* Inside(std::size_t const index)
+		{
+			return interior.data() + index * Interior;
+		};
+
+		void Release(std::size_t const index)
+		{
+			free.push_back(index);
+		};
+
+		// Panels allocated and not released
+		std::size_t Size() const
+		{
+			return a.size() - free.size();
+		};
+
+		// Releases all panels at once, the memory is kept for the next call
+		void Clear()
+		{
+			a.clear();
+			b.clear();
+			fa.clear();
+			fb.clear();
+			estimate.clear();
+			error.clear();
+			interior.clear();
+			free.clear();
+			queue.Clear();
+		};
+
+		// Returns the memory
+		void Trim()
+		{
+			Clear();
+			a.shrink_to_fit();
+			b.shrink_to_fit();
+			fa.shrink_to_fit();
+			fb.shrink_to_fit();
+			estimate.shrink_to_fit();
+			error.shrink_to_fit();
+			interior.shrink_to_fit();
+			free.shrink_to_fit();
+		};
+
+	private:
+		std::vector<std::size_t> free;
+	};
+
+	// Workspace of the calling thread for the life of the lease, cleared and kept between calls.
+	// A callback which integrates again gets a workspace of its own.
+	// Workspace has a default constructor and Clear().
+	template <typename Workspace>
+	class Lease
+	{
+	public:
+		Lease()
+		{
+			if (depth == workspaces.size())
+				workspaces.emplace_back();
+			workspace = &workspaces[depth++];
+			workspace->Clear();
+		};
+
+		Lease(Lease const&) = delete;
+		Lease& operator=(Lease const&) = delete;
+
+		~Lease()
+		{
+			workspace->Clear();
+			--depth;
+		};
+
+		Workspace& operator*() const
+		{
+			return *workspace;
+		};
+
+		Workspace* operator->() const
+		{
+			return workspace;
+		};
+
+		// Returns the memory of the workspaces of this thread, outside of any lease
+		static void Trim()
+		{
+			for (std::size_t i{ depth };i < workspaces.size();++i)
+				workspaces[i].Trim();
+		};
+
+	private:
+		// Deque, the addresses of workspaces stay when more are added
+		static inline thread_local std::deque<Workspace> workspaces;
+		static inline thread_local std::size_t depth{ 0 };
+
+		Workspace* workspace{ nullptr };
+	};
+
+	template <typename Value = Real, std::size_t Interior = 0>
+	using PanelLease = Lease<PanelArena<Value, Interior>>;
+
+};
@@ -0,0 +1,74 @@
+/* Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+ *
+ * Licensed under the GNU Lesser General Public License, version 3.0 or later
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or ( at your option ) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+ */
+
+/* C ABI of integrand plugins, shared objects loaded with dlopen.
+ *
+ * An integrand is called with n abscissae at once, and fills y[i] = f(x[i]).
+ * It may be called from several threads at the same time.
+ *
+ * A plugin exports
+ *	unsigned quadrature_plugin_version(void);	returns QUADRATURE_PLUGIN_VERSION
+ *	const quadrature_integrand* quadrature_plugin_integrands(size_t* count);
+ */
+
+#ifndef QUADRATURE_PLUGIN_H
+#define QUADRATURE_PLUGIN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QUADRATURE_PLUGIN_VERSION 1u
+
+/* Double-double, the unevaluated sum hi + lo with |lo| <= ulp(hi) / 2 */
+typedef struct
+{
+	double hi;
+	double lo;
+} quadrature_dd;
+
+typedef void (*quadrature_eval)(const double* x, double* y, size_t n, void* ctx);
+typedef void (*quadrature_eval_dd)(const quadrature_dd* x, quadrature_dd* y, size_t n, void* ctx);
+
+/* IEEE binary128, where the compiler has it */
+#if defined(__SIZEOF_FLOAT128__)
+typedef __float128 quadrature_quad;
+typedef void (*quadrature_eval_quad)(const quadrature_quad* x, quadrature_quad* y, size_t n, void* ctx);
+#else
+typedef void (*quadrature_eval_quad)(const void* x, void* y, size_t n, void* ctx);
+#endif
+
+typedef struct
+{
+	const char* name;
+	quadrature_eval eval; /* Required */
+	quadrature_eval_quad eval_quad; /* Optional, NULL if not provided */
+	quadrature_eval_dd eval_dd; /* Optional, NULL if not provided */
+	void* ctx; /* Passed to every call */
+} quadrature_integrand;
+
+typedef unsigned (*quadrature_plugin_version_t)(void);
+typedef const quadrature_integrand* (*quadrature_plugin_integrands_t)(size_t* count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+
+#include "./quadrature.hpp"
+#include "./plugin.h"
+#include "./registry.hpp"
+
+// Integrands from shared objects with the C ABI of plugin.h,
+// written in any language which can export C functions
+namespace Quadrature
+{
+	namespace Detail
+	{
+		// Real to double-double and back
+		quadrature_dd ToDoubleDouble(Real const& x)
+		{
+			double const hi = static_cast<double>(x);
+			return { hi, static_cast<double>(x - Real(hi)) };
+		};
+
+		Real FromDoubleDouble(quadrature_dd const& x)
+		{
+			return Real(x.hi) + Real(x.lo);
+		};
+
+		// Batch over the entry point closest to the precision of Real,
+		// binary128 if Real is, then double-double, then double.
+		// Arguments are converted once per batch, not per abscissa,
+		// in buffers kept by each thread.
+		Batch PluginBatch(
+			quadrature_integrand const& integrand,
+			std::shared_ptr<void> const& library)
+		{
+			void* const context = integrand.ctx;
+
+#if defined(__SIZEOF_FLOAT128__)
+			if constexpr ((sizeof(Real) == sizeof(quadrature_quad)) && (std::numeric_limits<Real>::digits == 113))
+			{
+				if (integrand.eval_quad)
+					return [library, eval = integrand.eval_quad, context](std::span<Real const> x, std::span<Real> y)
+					{
+						eval(reinterpret_cast<quadrature_quad const*>(x.data()), reinterpret_cast<quadrature_quad*>(y.data()), x.size(), context);
+					};
+			}
+#endif
+			if constexpr (std::numeric_limits<Real>::digits > std::numeric_limits<double>::digits)
+			{
+				if (integrand.eval_dd)
+					return [library, eval = integrand.eval_dd, context](std::span<Real const> x, std::span<Real> y)
+					{
+						thread_local std::vector<quadrature_dd> in;
+						thread_local std::vector<quadrature_dd> out;
+						in.resize(x.size());
+						out.resize(x.size());
+						for (std::size_t i{ 0 };i < x.size();++i)
+							in[i] = ToDoubleDouble(x[i]);
+						eval(in.data(), out.data(), x.size(), context);
+						for (std::size_t i{ 0 };i < x.size();++i)
+							y[i] = FromDoubleDouble(out[i]);
+					};
+			}
+
+			return [library, eval = integrand.eval, context](std::span<Real const> x, std::span<Real> y)
+			{
+				thread_local std::vector<double> in;
+				thread_local std::vector<double> out;
+				in.assign(x.begin(), x.end());
+				out.resize(x.size());
+				eval(in.data(), out.data(), x.size(), context);
+				std::copy(out.begin(), out.end(), y.begin());
+			};
+		};
+	};
+
+	// Registers the integrands of a plugin, returns how many.
+	// Returns 0 if the file can not be loaded, or is not a plugin of this version.
+	// The library stays loaded while the registry holds any of its integrands.
+	std::size_t LoadPlugin(
+		Registry& registry,
+		std::string const& path)
+	{
+		void* const handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (!handle)
+			return 0;
+		std::shared_ptr<void> const library(handle, dlclose);
+
+		auto const version = reinterpret_cast<quadrature_plugin_version_t>(dlsym(handle, "quadrature_plugin_version"));
+		auto const integrands = reinterpret_cast<quadrature_plugin_integrands_t>(dlsym(handle, "quadrature_plugin_integrands"));
+		if (!version || !integrands || (version() != QUADRATURE_PLUGIN_VERSION))
+			return 0;
+
+		std::size_t count{ 0 };
+		quadrature_integrand const* table = integrands(&count);
+		std::size_t registered{ 0 };
+		for (quadrature_integrand const& integrand : std::span<quadrature_integrand const>(table, table ? count : 0))
+		{
+			if (!integrand.name || !integrand.eval)
+				continue;
+			registry.Add(integrand.name, Detail::PluginBatch(integrand, library));
+			++registered;
+		};
+		return registered;
+	};
+
+};
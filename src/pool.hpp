@@ -0,0 +1,411 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+// Threads of the parallel engines, started once for the whole process.
+//
+// Workers are pinned to the cores the process may run on, ordered by NUMA node.
+// Memory a worker touches first, as the workspaces of panel.hpp, is placed on its node by the kernel,
+// and stays there since the worker does not move.
+namespace Quadrature
+{
+	namespace Detail
+	{
+		// Cores the process may run on, and their NUMA nodes, numbered from 0
+		struct Topology
+		{
+			std::vector<unsigned> cores; // By node, then core
+			std::vector<unsigned> node; // By core
+			unsigned nodes{ 1 };
+
+			Topology()
+			{
+				cpu_set_t allowed;
+				CPU_ZERO(&allowed);
+				if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+				{
+					for (unsigned core{ 0 };core < CPU_SETSIZE;++core)
+						if (CPU_ISSET(core, &allowed))
+							cores.push_back(core);
+				}
+				if (cores.empty())
+					for (unsigned core{ 0 };core < std::max(std::thread::hardware_concurrency(), 1u);++core)
+						cores.push_back(core);
+
+				node.assign(cores.back() + 1, 0);
+
+				// Nodes from sysfs, without libnuma, renumbered over those with allowed cores
+				std::vector<unsigned> found(cores.back() + 1, UINT32_MAX);
+				for (unsigned n{ 0 };n < 1024;++n)
+				{
+					std::ifstream list("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+					if (!list)
+						continue;
+					// As "0-3,8-11", empty for nodes of memory only
+					std::string text;
+					std::getline(list, text);
+					char const* next = text.data();
+					char const* const end = text.data() + text.size();
+					while (next < end)
+					{
+						unsigned first{ 0 };
+						auto parsed = std::from_chars(next, end, first);
+						if (parsed.ec != std::errc())
+							break;
+						unsigned last{ first };
+						if ((parsed.ptr < end) && (*parsed.ptr == '-'))
+							parsed = std::from_chars(parsed.ptr + 1, end, last);
+						for (unsigned core{ first };(core <= last) && (core < found.size());++core)
+							found[core] = n;
+						next = parsed.ptr + 1;
+					};
+				};
+
+				std::vector<unsigned> numbers;
+				for (unsigned const& core : cores)
+					if (found[core] != UINT32_MAX)
+						numbers.push_back(found[core]);
+				std::sort(numbers.begin(), numbers.end());
+				numbers.erase(std::unique(numbers.begin(), numbers.end()), numbers.end());
+				nodes = std::max<unsigned>(numbers.size(), 1);
+				for (unsigned const& core : cores)
+					if (found[core] != UINT32_MAX)
+						node[core] = std::lower_bound(numbers.begin(), numbers.end(), found[core]) - numbers.begin();
+
+				std::stable_sort(cores.begin(), cores.end(), [this](unsigned const& lhs, unsigned const& rhs) -> bool
+					{
+						return node[lhs] < node[rhs];
+					});
+			};
+		};
+	};
+
+	class ThreadPool
+	{
+	public:
+		// Threads of the pool, the caller of Run included (0 for all allowed cores),
+		// and whether workers are pinned. False if the pool has already started.
+		static bool Configure(
+			unsigned const threads,
+			bool const pin = true)
+		{
+			std::lock_guard lock(Options().mutex);
+			if (Options().started)
+				return false;
+			Options().threads = threads;
+			Options().pin = pin;
+			return true;
+		};
+
+		// Started on first use
+		static ThreadPool& Instance()
+		{
+			static ThreadPool pool;
+			return pool;
+		};
+
+		// Threads, the caller of Run included
+		unsigned Size() const
+		{
+			return workers.size() + 1;
+		};
+
+		unsigned Nodes() const
+		{
+			return topology.nodes;
+		};
+
+		// Node of the calling thread
+		static unsigned Node()
+		{
+			if (!pinned)
+			{
+				int const core = sched_getcpu();
+				Topology const& topology = Instance().topology;
+				return ((core >= 0) && (static_cast<std::size_t>(core) < topology.node.size())) ? topology.node[core] : 0;
+			}
+			return node;
+		};
+
+		// Node of the n-th thread of a Run, the caller being the first
+		unsigned NodeOf(unsigned const thread) const
+		{
+			return thread ? worker_node[thread - 1] : Node();
+		};
+
+		// Runs task() on 'threads' threads, the caller included, until all return.
+		// Runs from inside a task run on the caller alone. So does a run while another thread
+		// runs the pool: it neither waits nor queues, and takes as long as on one thread.
+		// Callers on several threads at once who need the workers serialise their calls themselves.
+		// If task() throws, Run still waits for all threads, then rethrows the first exception,
+		// that of the caller if it threw.
+		template <typename Task>
+		void Run(
+			unsigned const threads,
+			Task const& task)
+		{
+			unsigned const wanted = std::min(std::max(threads, 1u), Size());
+			std::unique_lock exclusive(calling, std::try_to_lock);
+			if ((wanted == 1) || inside || !exclusive.owns_lock())
+			{
+				task();
+				return;
+			}
+
+			{
+				std::lock_guard lock(mutex);
+				this->task = &task;
+				this->call = [](void const* task) { (*static_cast<Task const*>(task))(); };
+				this->wanted = wanted - 1;
+				running = wanted - 1;
+				failure = nullptr;
+				++generation;
+			}
+			start.notify_all();
+
+			// The workers use the task until they return, also when the caller's share throws
+			struct Join
+			{
+				ThreadPool& pool;
+
+				~Join()
+				{
+					inside = false;
+					std::unique_lock lock(pool.mutex);
+					pool.finish.wait(lock, [this]() -> bool { return !pool.running; });
+				};
+			};
+			{
+				Join const join{ *this };
+				inside = true;
+				task();
+			}
+
+			std::exception_ptr thrown;
+			{
+				std::lock_guard lock(mutex);
+				std::swap(thrown, failure);
+			}
+			if (thrown)
+				std::rethrow_exception(thrown);
+		};
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard lock(mutex);
+				stopping = true;
+			}
+			start.notify_all();
+		};
+
+	private:
+		using Topology = Detail::Topology;
+
+		struct Settings
+		{
+			std::mutex mutex;
+			unsigned threads{ 0 };
+			bool pin{ true };
+			bool started{ false };
+		};
+
+		static Settings& Options()
+		{
+			static Settings settings;
+			return settings;
+		};
+
+		ThreadPool()
+		{
+			unsigned threads{ 0 };
+			bool pin{ true };
+			{
+				std::lock_guard lock(Options().mutex);
+				Options().started = true;
+				threads = Options().threads;
+				pin = Options().pin;
+			}
+			if (!threads)
+				threads = topology.cores.size();
+
+			// The first core is left to the caller of Run, which is not pinned
+			std::vector<unsigned> worker_core;
+			for (unsigned w{ 0 };w + 1 < threads;++w)
+			{
+				worker_core.push_back(topology.cores[(w + 1) % topology.cores.size()]);
+				worker_node.push_back(topology.node[worker_core.back()]);
+			};
+			// If a thread cannot start, those started stop before their join
+			try
+			{
+				for (unsigned w{ 0 };w < worker_core.size();++w)
+					workers.emplace_back(&ThreadPool::Loop, this, w, pin ? static_cast<int>(worker_core[w]) : -1);
+			}
+			catch (...)
+			{
+				{
+					std::lock_guard lock(mutex);
+					stopping = true;
+				}
+				start.notify_all();
+				throw;
+			};
+		};
+
+		void Loop(
+			unsigned const index,
+			int const core)
+		{
+			if (core >= 0)
+			{
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				CPU_SET(core, &set);
+				pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+				node = worker_node[index];
+			}
+			inside = true;
+
+			uint64_t seen{ 0 };
+			std::unique_lock lock(mutex);
+			for (;;)
+			{
+				start.wait(lock, [this, &seen]() -> bool { return stopping || (generation != seen); });
+				if (stopping)
+					return;
+				seen = generation;
+				if (index >= wanted)
+					continue;
+
+				// An exception is kept for the caller, it would end the process on this thread
+				std::exception_ptr thrown;
+				lock.unlock();
+				try
+				{
+					call(task);
+				}
+				catch (...)
+				{
+					thrown = std::current_exception();
+				}
+				lock.lock();
+				if (thrown && !failure)
+					failure = thrown;
+				if (!--running)
+					finish.notify_all();
+			};
+		};
+
+		Topology topology;
+		std::vector<unsigned> worker_node;
+
+		std::mutex calling;
+		std::mutex mutex;
+		std::condition_variable start;
+		std::condition_variable finish;
+		void const* task{ nullptr };
+		void (*call)(void const*) { nullptr };
+		unsigned wanted{ 0 };
+		unsigned running{ 0 };
+		std::exception_ptr failure; // First thrown by a worker
+		uint64_t generation{ 0 };
+		bool stopping{ false };
+		std::vector<std::jthread> workers;
+
+		static inline thread_local bool inside{ false };
+		static inline thread_local bool pinned{ false };
+		static inline thread_local unsigned node{ 0 };
+	};
+
+	// Indices [0, count) for the threads of a Run, in place of an atomic counter.
+	// Split in a range per NUMA node, by the threads on each. A thread takes from
+	// the range of its own node first, then from the other nodes.
+	class WorkIndices
+	{
+	public:
+		WorkIndices(
+			std::size_t const count,
+			unsigned const threads)
+			: count(count)
+		{
+			ThreadPool const& pool = ThreadPool::Instance();
+			unsigned const nodes = pool.Nodes();
+			unsigned const participants = std::min(std::max(threads, 1u), pool.Size());
+
+			std::vector<std::size_t> weight(nodes, 0);
+			for (unsigned t{ 0 };t < participants;++t)
+				++weight[pool.NodeOf(t)];
+
+			ranges = std::vector<Range>(nodes);
+			std::size_t first{ 0 };
+			std::size_t seen{ 0 };
+			for (unsigned n{ 0 };n < nodes;++n)
+			{
+				seen += weight[n];
+				std::size_t const last = count * seen / participants;
+				ranges[n].next = first;
+				ranges[n].end = last;
+				first = last;
+			};
+		};
+
+		// Next index, 'count' once all are taken
+		std::size_t Next()
+		{
+			std::size_t const home = ThreadPool::Node();
+			for (std::size_t k{ 0 };k < ranges.size();++k)
+			{
+				Range& range = ranges[(home + k) % ranges.size()];
+				if (range.next.load(std::memory_order_relaxed) >= range.end)
+					continue;
+				std::size_t const index = range.next++;
+				if (index < range.end)
+					return index;
+			};
+			return count;
+		};
+
+	private:
+		// Own cache line, threads of one node do not disturb the others
+		struct alignas(64) Range
+		{
+			std::atomic<std::size_t> next{ 0 };
+			std::size_t end{ 0 };
+		};
+
+		std::size_t count;
+		std::vector<Range> ranges;
+	};
+
+};
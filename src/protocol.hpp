@@ -0,0 +1,242 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+// Binary protocol of the integration daemon, host byte order (a Unix socket stays on one host).
+//
+// Client to daemon, a frame of jobs:
+//	uint32 magic, uint32 count (at most max_jobs), then per job
+//	uint64 id, double a, double b, double epsilon, uint8 max_depth, uint8 name length, name
+//
+// Daemon to client, one reply per job as it completes, in any order:
+//	uint64 id, double value, double error, uint64 evaluations, uint8 status
+namespace Quadrature::Protocol
+{
+	constexpr uint32_t magic{ 0x31524451 }; // "QDR1"
+
+	// Jobs of a frame, larger counts are not frames
+	constexpr uint32_t max_jobs{ 1 << 16 };
+
+	struct Job
+	{
+		uint64_t id{ 0 };
+		double a{ 0 };
+		double b{ 0 };
+		double epsilon{ 1e-10 };
+		uint8_t max_depth{ 2 };
+		std::string name;
+	};
+
+	struct Reply
+	{
+		uint64_t id{ 0 };
+		double value{ 0 };
+		double error{ 0 };
+		uint64_t evaluations{ 0 };
+		uint8_t status{ 0 }; // Quadrature::Status
+	};
+
+	constexpr std::size_t reply_size{ 8 + 8 + 8 + 8 + 1 };
+
+	namespace Detail
+	{
+		template <typename T>
+		void Put(
+			std::vector<char>& out,
+			T const& value)
+		{
+			char const* bytes = reinterpret_cast<char const*>(&value);
+			out.insert(out.end(), bytes, bytes + sizeof(T));
+		};
+
+		// False if fewer than sizeof(T) bytes are left
+		template <typename T>
+		bool Get(
+			std::span<char const> in,
+			std::size_t& position,
+			T& value)
+		{
+			if (in.size() - position < sizeof(T))
+				return false;
+			std::memcpy(&value, in.data() + position, sizeof(T));
+			position += sizeof(T);
+			return true;
+		};
+
+		// False if the job is not complete, 'position' is then left as it was
+		bool Get(
+			std::span<char const> in,
+			std::size_t& position,
+			Job& job)
+		{
+			std::size_t next{ position };
+			uint8_t length{ 0 };
+			if (!Get(in, next, job.id) ||
+				!Get(in, next, job.a) ||
+				!Get(in, next, job.b) ||
+				!Get(in, next, job.epsilon) ||
+				!Get(in, next, job.max_depth) ||
+				!Get(in, next, length) ||
+				(in.size() - next < length))
+				return false;
+			job.name.assign(in.data() + next, length);
+			position = next + length;
+			return true;
+		};
+	};
+
+	void Encode(
+		std::span<Job const> jobs,
+		std::vector<char>& out)
+	{
+		Detail::Put(out, magic);
+		Detail::Put(out, static_cast<uint32_t>(jobs.size()));
+		for (Job const& job : jobs)
+		{
+			Detail::Put(out, job.id);
+			Detail::Put(out, job.a);
+			Detail::Put(out, job.b);
+			Detail::Put(out, job.epsilon);
+			Detail::Put(out, job.max_depth);
+			uint8_t const length = static_cast<uint8_t>(std::min<std::size_t>(job.name.size(), 255));
+			Detail::Put(out, length);
+			out.insert(out.end(), job.name.begin(), job.name.begin() + length);
+		};
+	};
+
+	// Decodes one frame from the start of 'in', returns the bytes used,
+	// 0 if the frame is not complete yet. 'valid' is false if it is not a frame at all.
+	std::size_t Decode(
+		std::span<char const> in,
+		std::vector<Job>& jobs,
+		bool& valid)
+	{
+		valid = true;
+		std::size_t position{ 0 };
+		uint32_t header{ 0 };
+		uint32_t count{ 0 };
+		if (!Detail::Get(in, position, header))
+			return 0;
+		if (header != magic)
+		{
+			valid = false;
+			return 0;
+		}
+		if (!Detail::Get(in, position, count))
+			return 0;
+		if (count > max_jobs)
+		{
+			valid = false;
+			return 0;
+		}
+
+		std::size_t const first = jobs.size();
+		for (uint32_t j{ 0 };j < count;++j)
+		{
+			Job job;
+			if (!Detail::Get(in, position, job))
+			{
+				jobs.resize(first);
+				return 0;
+			}
+			jobs.push_back(std::move(job));
+		};
+		return position;
+	};
+
+	// Frames read from a stream, in pieces as they arrive. Each job is decoded once,
+	// and handed out as soon as it is complete, without waiting for the rest of its frame.
+	class Decoder
+	{
+	public:
+		// Appends the complete jobs at the start of 'in', returns the bytes used,
+		// the rest is to be passed again with the bytes that follow.
+		// 'valid' is false if the stream is not made of frames.
+		std::size_t Feed(
+			std::span<char const> in,
+			std::vector<Job>& jobs,
+			bool& valid)
+		{
+			valid = true;
+			std::size_t position{ 0 };
+			for (;;)
+			{
+				if (!remaining)
+				{
+					std::size_t next{ position };
+					uint32_t header{ 0 };
+					uint32_t count{ 0 };
+					if (!Detail::Get(in, next, header) || !Detail::Get(in, next, count))
+						return position;
+					if ((header != magic) || (count > max_jobs))
+					{
+						valid = false;
+						return position;
+					}
+					position = next;
+					remaining = count;
+					continue;
+				}
+
+				Job job;
+				if (!Detail::Get(in, position, job))
+					return position;
+				jobs.push_back(std::move(job));
+				--remaining;
+			};
+		};
+
+	private:
+		uint32_t remaining{ 0 }; // Jobs of the current frame not yet decoded
+	};
+
+	void Encode(
+		Reply const& reply,
+		std::vector<char>& out)
+	{
+		Detail::Put(out, reply.id);
+		Detail::Put(out, reply.value);
+		Detail::Put(out, reply.error);
+		Detail::Put(out, reply.evaluations);
+		Detail::Put(out, reply.status);
+	};
+
+	// False if fewer than reply_size bytes are left
+	bool Decode(
+		std::span<char const> in,
+		std::size_t& position,
+		Reply& reply)
+	{
+		if (in.size() - position < reply_size)
+			return false;
+		Detail::Get(in, position, reply.id);
+		Detail::Get(in, position, reply.value);
+		Detail::Get(in, position, reply.error);
+		Detail::Get(in, position, reply.evaluations);
+		Detail::Get(in, position, reply.status);
+		return true;
+	};
+
+};
@@ -0,0 +1,475 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./pool.hpp"
+
+// Quasi-Monte Carlo integration over a hyperrectangle [a;b],
+// for dimensions where deterministic rules are too expensive
+namespace Quadrature
+{
+	// SplitMix64
+	// Sebastiano Vigna
+	//
+	// Small deterministic generator, used to derive the randomisation of each replica,
+	// so a seed gives identical results on every platform
+	uint64_t SplitMix64(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	};
+
+	// Sobol sequence, with random linear scrambling and digital shift
+	// Constructing Sobol sequences with better two-dimensional projections
+	// S. Joe, F. Y. Kuo
+	//
+	// Up to 40 dimensions, 2^64 points
+	class Sobol
+	{
+	public:
+		static constexpr std::size_t max_dimensions{ 40 };
+
+		// Primitive polynomial degree s, coefficients a, initial direction numbers m
+		struct Direction
+		{
+			uint8_t s;
+			uint8_t a;
+			std::array<uint8_t, 8> m;
+		};
+
+		// Dimensions 2 to 40, the first dimension is the van der Corput sequence
+		static constexpr std::array<Direction, max_dimensions - 1> table{ {
+			{ 1, 0, { 1 } },
+			{ 2, 1, { 1, 3 } },
+			{ 3, 1, { 1, 3, 1 } },
+			{ 3, 2, { 1, 1, 1 } },
+			{ 4, 1, { 1, 1, 3, 3 } },
+			{ 4, 4, { 1, 3, 5, 13 } },
+			{ 5, 2, { 1, 1, 5, 5, 17 } },
+			{ 5, 4, { 1, 1, 5, 5, 5 } },
+			{ 5, 7, { 1, 1, 7, 11, 19 } },
+			{ 5, 11, { 1, 1, 5, 1, 1 } },
+			{ 5, 13, { 1, 1, 1, 3, 11 } },
+			{ 5, 14, { 1, 3, 5, 5, 31 } },
+			{ 6, 1, { 1, 3, 3, 9, 7, 49 } },
+			{ 6, 13, { 1, 1, 1, 15, 21, 21 } },
+			{ 6, 16, { 1, 3, 1, 13, 27, 49 } },
+			{ 6, 19, { 1, 1, 1, 15, 7, 5 } },
+			{ 6, 22, { 1, 3, 1, 15, 13, 25 } },
+			{ 6, 25, { 1, 1, 5, 5, 19, 61 } },
+			{ 7, 1, { 1, 3, 7, 11, 23, 15, 103 } },
+			{ 7, 4, { 1, 3, 7, 13, 13, 15, 69 } },
+			{ 7, 7, { 1, 1, 3, 13, 7, 35, 63 } },
+			{ 7, 8, { 1, 3, 5, 9, 1, 25, 53 } },
+			{ 7, 14, { 1, 3, 1, 13, 9, 35, 107 } },
+			{ 7, 19, { 1, 3, 1, 5, 27, 61, 31 } },
+			{ 7, 21, { 1, 1, 5, 11, 19, 41, 61 } },
+			{ 7, 28, { 1, 3, 5, 3, 3, 13, 69 } },
+			{ 7, 31, { 1, 1, 7, 13, 1, 19, 1 } },
+			{ 7, 32, { 1, 3, 7, 5, 13, 19, 59 } },
+			{ 7, 37, { 1, 1, 3, 9, 25, 29, 41 } },
+			{ 7, 41, { 1, 3, 5, 13, 23, 1, 55 } },
+			{ 7, 42, { 1, 3, 7, 3, 13, 59, 17 } },
+			{ 7, 50, { 1, 3, 1, 3, 5, 53, 69 } },
+			{ 7, 55, { 1, 1, 5, 5, 23, 33, 13 } },
+			{ 7, 56, { 1, 1, 7, 7, 1, 61, 123 } },
+			{ 7, 59, { 1, 1, 7, 9, 13, 61, 49 } },
+			{ 7, 62, { 1, 3, 3, 5, 3, 55, 33 } },
+			{ 8, 14, { 1, 3, 1, 15, 31, 13, 49, 245 } },
+			{ 8, 21, { 1, 3, 5, 15, 31, 59, 63, 97 } },
+			{ 8, 22, { 1, 3, 1, 11, 11, 11, 77, 249 } }
+		} };
+
+		// Replica 'seed' = 0 is the unscrambled sequence
+		Sobol(
+			std::size_t const dimensions,
+			uint64_t const seed = 0)
+			: dimensions(std::min(dimensions, max_dimensions)),
+			direction(64 * this->dimensions),
+			shift(this->dimensions, 0)
+		{
+			for (std::size_t j{ 0 };j < this->dimensions;++j)
+			{
+				uint64_t* v = &direction[64 * j];
+				if (!j)
+				{
+					for (uint8_t k{ 0 };k < 64;++k)
+						v[k] = uint64_t(1) << (63 - k);
+				}
+				else
+				{
+					Direction const& entry = table[j - 1];
+					for (uint8_t k{ 0 };k < entry.s;++k)
+						v[k] = uint64_t(entry.m[k]) << (63 - k);
+					for (uint8_t k{ entry.s };k < 64;++k)
+					{
+						v[k] = v[k - entry.s] ^ (v[k - entry.s] >> entry.s);
+						for (uint8_t i{ 1 };i < entry.s;++i)
+							if ((entry.a >> (entry.s - 1 - i)) & 1)
+								v[k] ^= v[k - i];
+					};
+				};
+			};
+
+			if (!seed)
+				return;
+
+			// Matousek, random lower triangular (unit diagonal) matrix per dimension,
+			// applied to every direction number, followed by a random digital shift
+			uint64_t state = seed;
+			for (std::size_t j{ 0 };j < this->dimensions;++j)
+			{
+				std::array<uint64_t, 64> rows;
+				for (uint8_t r{ 0 };r < 64;++r)
+				{
+					// Row r has bit r (from the top) set, random bits above it
+					uint64_t const diagonal = uint64_t(1) << (63 - r);
+					uint64_t const above = r ? ~((diagonal << 1) - 1) : 0;
+					rows[r] = diagonal | (SplitMix64(state) & above);
+				};
+
+				uint64_t* v = &direction[64 * j];
+				for (uint8_t k{ 0 };k < 64;++k)
+				{
+					uint64_t scrambled{ 0 };
+					for (uint8_t r{ 0 };r < 64;++r)
+						if (std::popcount(rows[r] & v[k]) & 1)
+							scrambled |= uint64_t(1) << (63 - r);
+					v[k] = scrambled;
+				};
+				shift[j] = SplitMix64(state);
+			};
+		};
+
+		std::size_t Dimensions() const { return dimensions; };
+
+		// Points 'first' to 'first + count', in Gray code order,
+		// point major into 'points' (count * dimensions values in [0;1))
+		void Fill(
+			uint64_t const first,
+			std::size_t const count,
+			std::span<Real> points) const
+		{
+			if (!count)
+				return;
+
+			std::vector<uint64_t> x(shift);
+			uint64_t const gray = first ^ (first >> 1);
+			for (std::size_t j{ 0 };j < dimensions;++j)
+				for (uint8_t k{ 0 };k < 64;++k)
+					if ((gray >> k) & 1)
+						x[j] ^= direction[64 * j + k];
+
+			for (std::size_t i{ 0 };i < count;++i)
+			{
+				if (i)
+				{
+					// Consecutive Gray codes differ in the lowest zero bit of the previous index
+					uint8_t const k = static_cast<uint8_t>(std::countr_one(first + i - 1));
+					for (std::size_t j{ 0 };j < dimensions;++j)
+						x[j] ^= direction[64 * j + k];
+				};
+				for (std::size_t j{ 0 };j < dimensions;++j)
+					points[i * dimensions + j] = std::ldexp(static_cast<Real>(x[j]), -64);
+			};
+		};
+
+	private:
+		std::size_t dimensions;
+		std::vector<uint64_t> direction; // 64 per dimension, most significant bit first
+		std::vector<uint64_t> shift;
+	};
+
+	// Rank-1 lattice, x_k = frac(k z / n + shift)
+	// Lattice Methods for Multiple Integration
+	// I. H. Sloan, S. Joe
+	//
+	// Best used with a published generating vector 'z' for 'n' points.
+	// Random shift per replica, replica 'seed' = 0 is unshifted.
+	class Lattice
+	{
+	public:
+		Lattice(
+			std::vector<uint64_t> generator,
+			uint64_t const n,
+			uint64_t const seed = 0)
+			: generator(std::move(generator)),
+			n(std::max<uint64_t>(n, 1)),
+			shift(this->generator.size(), 0)
+		{
+			if (!seed)
+				return;
+			uint64_t state = seed;
+			for (Real& s : shift)
+				s = std::ldexp(static_cast<Real>(SplitMix64(state)), -64);
+		};
+
+		// Korobov generating vector z = (1, g, g^2, ...) mod n,
+		// 'g' chosen among 'candidates' values by the P2 criterion, with weights 1/j^2.
+		// Costs candidates * n * dimensions operations.
+		static std::vector<uint64_t> Korobov(
+			std::size_t const dimensions,
+			uint64_t const n,
+			std::size_t const candidates = 64)
+		{
+			std::vector<uint64_t> z(dimensions, 1);
+			if ((dimensions < 2) || (n < 3))
+				return z;
+
+			// Bernoulli polynomial 2 pi^2 B2(x)
+			auto omega = [](Real const& x) -> Real
+			{
+				return 2 * pi * pi * (x * x - x + Real(1) / 6);
+			};
+
+			auto generator = [&dimensions, &n](uint64_t const& g) -> std::vector<uint64_t>
+			{
+				std::vector<uint64_t> z(dimensions, 1);
+				for (std::size_t j{ 1 };j < dimensions;++j)
+					z[j] = static_cast<uint64_t>((static_cast<unsigned __int128>(z[j - 1]) * g) % n);
+				return z;
+			};
+
+			Real best{ std::numeric_limits<Real>::max() };
+			uint64_t const stride = std::max<uint64_t>(1, (n - 2) / candidates);
+			for (uint64_t g{ 2 };g < n;g += stride)
+			{
+				if (std::gcd(g, n) != 1)
+					continue;
+				std::vector<uint64_t> const trial = generator(g);
+				Real error{ 0 };
+				for (uint64_t k{ 0 };k < n;++k)
+				{
+					Real product{ 1 };
+					for (std::size_t j{ 0 };j < dimensions;++j)
+					{
+						uint64_t const r = static_cast<uint64_t>((static_cast<unsigned __int128>(k) * trial[j]) % n);
+						product *= 1 + omega(static_cast<Real>(r) / n) / Real((j + 1) * (j + 1));
+					};
+					error += product;
+				};
+				if (error < best)
+				{
+					best = error;
+					z = trial;
+				};
+			};
+			return z;
+		};
+
+		std::size_t Dimensions() const { return generator.size(); };
+		uint64_t Points() const { return n; };
+
+		void Fill(
+			uint64_t const first,
+			std::size_t const count,
+			std::span<Real> points) const
+		{
+			std::size_t const dimensions = generator.size();
+			for (std::size_t i{ 0 };i < count;++i)
+				for (std::size_t j{ 0 };j < dimensions;++j)
+				{
+					uint64_t const r = static_cast<uint64_t>(
+						(static_cast<unsigned __int128>(first + i) * generator[j]) % n);
+					Real x = static_cast<Real>(r) / n + shift[j];
+					points[i * dimensions + j] = (x < 1) ? x : x - 1;
+				};
+		};
+
+	private:
+		std::vector<uint64_t> generator;
+		uint64_t n;
+		std::vector<Real> shift;
+	};
+
+	// Randomised quasi-Monte Carlo
+	//
+	// 'replicas' independently randomised copies of the sequence, 'points' each.
+	// The estimate is their mean, the error the standard error of the mean.
+	//
+	// Work is split into blocks of consecutive indices, taken by the threads.
+	// Each block sum is stored, and summed in index order afterwards,
+	// so the result is independent of the number of threads.
+	//
+	// 'sequence' returns the generator of a replica, from its seed:
+	//   Generator sequence(uint64_t seed)
+	// The integrand is called with a block of points in [a;b] (point major):
+	//   void integrand(std::span<Real const> points, std::span<Real> values)
+	template <typename Sequence, typename Integrand>
+	Result<Real> QuasiMonteCarlo(
+		Sequence const& sequence,
+		Integrand const& integrand,
+		std::span<Real const> a,
+		std::span<Real const> b,
+		uint64_t const points,
+		std::size_t const a_replicas = 16,
+		uint64_t const seed = 1,
+		unsigned const a_threads = std::thread::hardware_concurrency())
+	{
+		Result<Real> result;
+
+		std::size_t const d = a.size();
+		if (!d || (b.size() != d) || !points)
+		{
+			result.value = NaN;
+			result.status = Status::invalid;
+			return result;
+		}
+
+		// Error estimate needs at least two replicas
+		std::size_t const replicas = std::max<std::size_t>(a_replicas, 2);
+		unsigned const threads = std::max(a_threads, 1u);
+
+		constexpr uint64_t block{ 4096 };
+		uint64_t const blocks = (points + block - 1) / block;
+
+		// Replica seeds derived from the seed, never zero (unrandomised)
+		using Generator = std::invoke_result_t<Sequence const&, uint64_t>;
+		std::vector<Generator> generators;
+		generators.reserve(replicas);
+		uint64_t state = seed;
+		for (std::size_t r{ 0 };r < replicas;++r)
+			generators.push_back(sequence(SplitMix64(state) | 1));
+
+		if (generators.front().Dimensions() != d)
+		{
+			result.value = NaN;
+			result.status = Status::invalid;
+			return result;
+		}
+
+		Real volume{ 1 };
+		for (std::size_t i{ 0 };i < d;++i)
+			volume *= std::abs(b[i] - a[i]);
+
+		std::vector<Real> sums(replicas * blocks, 0);
+		unsigned const participants = std::min<uint64_t>(threads, replicas * blocks);
+		WorkIndices indices(replicas * blocks, participants);
+		std::atomic<bool> finite{ true };
+
+		auto worker = [&]()
+		{
+			std::vector<Real> batch_points(block * d);
+			std::vector<Real> batch_values(block);
+			for (uint64_t unit = indices.Next();unit < replicas * blocks;unit = indices.Next())
+			{
+				std::size_t const replica = unit / blocks;
+				uint64_t const first = (unit % blocks) * block;
+				std::size_t const count = static_cast<std::size_t>(std::min(block, points - first));
+
+				std::span<Real> x(batch_points.data(), count * d);
+				generators[replica].Fill(first, count, x);
+				for (std::size_t i{ 0 };i < count;++i)
+					for (std::size_t j{ 0 };j < d;++j)
+						x[i * d + j] = a[j] + (b[j] - a[j]) * x[i * d + j];
+
+				std::span<Real> y(batch_values.data(), count);
+				integrand(std::span<Real const>(x), y);
+
+				Real sum{ 0 };
+				for (Real const& value : y)
+					sum += value;
+				if (!std::isfinite(sum))
+					finite = false;
+				sums[unit] = sum;
+			};
+		};
+
+		ThreadPool::Instance().Run(participants, worker);
+
+		result.evaluations = replicas * points;
+		if (!finite)
+		{
+			result.value = NaN;
+			result.status = Status::not_finite;
+			return result;
+		}
+
+		std::vector<Real> estimate(replicas, 0);
+		for (std::size_t r{ 0 };r < replicas;++r)
+		{
+			for (uint64_t k{ 0 };k < blocks;++k)
+				estimate[r] += sums[r * blocks + k];
+			estimate[r] *= volume / points;
+		};
+
+		Real mean{ 0 };
+		for (Real const& e : estimate)
+			mean += e;
+		mean /= replicas;
+
+		Real variance{ 0 };
+		for (Real const& e : estimate)
+			variance += (e - mean) * (e - mean);
+		variance /= (replicas - 1);
+
+		result.value = mean;
+		result.error = std::sqrt(variance / replicas);
+		return result;
+	};
+
+	// Scrambled Sobol points, scalar integrand evaluated one point at a time
+	//   Real function(std::span<Real const> x)
+	template <typename Function>
+		requires std::invocable<Function const&, std::span<Real const>>
+	Result<Real> QuasiMonteCarlo(
+		Function const& function,
+		std::span<Real const> a,
+		std::span<Real const> b,
+		uint64_t const points = 1 << 16,
+		std::size_t const replicas = 16,
+		uint64_t const seed = 1)
+	{
+		std::size_t const d = a.size();
+		auto sobol = [&d](uint64_t const& replica_seed) -> Sobol
+		{
+			return Sobol(d, replica_seed);
+		};
+		auto batch = [&function, &d](std::span<Real const> x, std::span<Real> y)
+		{
+			for (std::size_t i{ 0 };i < y.size();++i)
+				y[i] = function(x.subspan(i * d, d));
+		};
+
+		if (d > Sobol::max_dimensions)
+		{
+			Result<Real> result;
+			result.value = NaN;
+			result.status = Status::invalid;
+			return result;
+		}
+		return QuasiMonteCarlo(sobol, batch, a, b, points, replicas, seed);
+	};
+
+};
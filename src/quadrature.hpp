@@ -18,12 +18,24 @@
 #pragma once
 
 #include <algorithm>
-#include <format>
-#include <functional>
-#include <iostream>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
 #include <limits>
 #include <numbers>
-#include <sstream>
+#include <type_traits>
+
+// Define QUADRATURE_FREESTANDING before including any header for targets
+// without streams or strings: RealToString, operator<< and complex integrands are left out
+#ifndef QUADRATURE_FREESTANDING
+#include <complex>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#endif
 
 // C++23
 #if __STDCPP_FLOAT128_T__ == 1
@@ -33,21 +45,35 @@ using Real = std::float128_t;
 using Real = long double;
 #endif
 
-std::string RealToString(
+// Formats 'value' into [first, last) without allocating, as std::to_chars.
+// Decimals = '0' outputs the shortest text which reads back to the same value,
+// else 'decimals' significant digits. No sign space, unlike RealToString
+std::to_chars_result RealToChars(
+	char* const first,
+	char* const last,
 	Real const& value,
-	uint8_t const& decimals = 8)
+	uint8_t const& decimals = 0)
 {
 	constexpr auto max_digits{ std::numeric_limits<Real>::digits10 + 1 };
 
+	return decimals ?
+		std::to_chars(first, last, value, std::chars_format::general, std::min<int>(decimals, max_digits)) :
+		std::to_chars(first, last, value);
+};
+
+#ifndef QUADRATURE_FREESTANDING
+std::string RealToString(
+	Real const& value,
+	uint8_t const& decimals = 8)
+{
 	// Decimals = '0' outputs all available decimals,
 	// unlike std::setprecision(0) which outputs none.
 	// A prefix space is added if value is positive (or zero)
-	std::stringstream stream{
-		decimals ?
-		std::format("{: .{}}", value, std::min<uint8_t>(decimals, max_digits)) :
-		std::format("{: }", value)
-	};
-	return stream.str();
+	std::array<char, 64> buffer;
+	buffer[0] = ' ';
+	char* const first = buffer.data() + !std::signbit(value);
+	auto const [last, error] = RealToChars(first, buffer.data() + buffer.size(), value, decimals);
+	return std::string(buffer.data(), last);
 };
 
 #if __STDCPP_FLOAT128_T__ == 1
@@ -56,9 +82,17 @@ std::ostream& operator<<(
 	std::ostream& os,
 	Real const& value)
 {
-	return os << RealToString(value, std::cout.precision());
+	// The precision of 'os', at most all significant digits; width and fill apply as for any value
+	constexpr auto max_digits{ std::numeric_limits<Real>::digits10 + 1 };
+	std::array<char, 64> buffer;
+	buffer[0] = ' ';
+	char* const first = buffer.data() + !std::signbit(value);
+	uint8_t const decimals = std::clamp<std::streamsize>(os.precision(), 1, max_digits);
+	auto const [last, error] = RealToChars(first, buffer.data() + buffer.size(), value, decimals);
+	return os << std::string_view(buffer.data(), last - buffer.data());
 };
 #endif
+#endif
 
 constexpr Real pi = std::numbers::pi_v<Real>;
 
@@ -75,13 +109,114 @@ Real static const numeric_interval = std::numeric_limits<double>::epsilon();
 // limited by recursive depth
 namespace Quadrature
 {
+	// Outcome of an engine which reports more than the integral
+	enum class Status : uint8_t
+	{
+		converged, // Error estimate below epsilon
+		limit, // Depth or evaluation limit reached first
+		not_finite, // Integrand returned NaN or infinity
+		invalid // Arguments outside the supported range
+	};
+
+	// Integral with its estimated (absolute) error,
+	// and the number of integrand evaluations used
+	template <typename Value = Real>
+	struct Result
+	{
+		Value value{};
+		Real error{ 0 };
+		std::size_t evaluations{ 0 };
+		Status status{ Status::converged };
+	};
+
+	// Integrand values may be real or complex,
+	// overload these two for other value types
+	bool IsFinite(Real const& value)
+	{
+		return std::isfinite(value);
+	};
+
+#ifndef QUADRATURE_FREESTANDING
+	bool IsFinite(std::complex<Real> const& value)
+	{
+		return std::isfinite(value.real()) && std::isfinite(value.imag());
+	};
+#endif
+
+	// Size of a value, for error tests, the modulus for complex values
+	Real Magnitude(Real const& value)
+	{
+		return std::abs(value);
+	};
+
+#ifndef QUADRATURE_FREESTANDING
+	Real Magnitude(std::complex<Real> const& value)
+	{
+		return std::abs(value);
+	};
+#endif
+
+	namespace Detail
+	{
+		// Type a value is summed in: Real for arithmetic types, std::complex<Real> for complex ones,
+		// any other type as it is, if IsFinite and Magnitude are overloaded for it (else none)
+		template <typename Value>
+		struct Accumulator
+		{
+		};
+
+		template <typename Value>
+			requires std::is_arithmetic_v<Value>
+		struct Accumulator<Value>
+		{
+			using type = Real;
+		};
+
+		template <typename Value>
+		constexpr bool is_complex{ false };
+
+#ifndef QUADRATURE_FREESTANDING
+		template <typename Value>
+		constexpr bool is_complex<std::complex<Value>>{ true };
+
+		template <typename Value>
+			requires std::is_arithmetic_v<Value>
+		struct Accumulator<std::complex<Value>>
+		{
+			using type = std::complex<Real>;
+		};
+#endif
+
+		template <typename Value>
+			requires (!std::is_arithmetic_v<Value> && !is_complex<Value>) && requires(Value const& value)
+		{
+			{ IsFinite(value) } -> std::convertible_to<bool>;
+			{ Magnitude(value) } -> std::convertible_to<Real>;
+		}
+		struct Accumulator<Value>
+		{
+			using type = Value;
+		};
+	};
+
+	// Type the integral of a value of type 'Value' is summed in
+	template <typename Value>
+	using Accumulated = typename Detail::Accumulator<std::decay_t<Value>>::type;
+
+	// Return type of an integrand f(x), as summed
+	template <typename Function>
+	using ValueOf = Accumulated<std::invoke_result_t<Function const&, Real>>;
+
 	// Algorithm 103
 	// Simpson's rule integrator
 	// Guy F. Kuncir
 	//
 	// Returns NaN if f(a),f(b) or f(a/2 + b/2), is NaN,
-	Real Simpson(
-		std::function<Real(Real)> const& function,
+	// the integrand may return Real or std::complex<Real>
+	template <typename Function, typename Value = ValueOf<Function>>
+		requires std::invocable<Function const&, Real>
+	Value Simpson(
+		Function const& function,
 		Real a,
 		Real b,
 		Real const& a_epsilon = 1e-10,
@@ -99,10 +234,10 @@ namespace Quadrature
 		struct Data
 		{
 			Real x{ 0 };
-			Real y{ 0 }; // f(x)
-			Real area{ 0 }; // F(x)[a;b]
+			Value y{ 0 }; // f(x)
+			Value area{ 0 }; // F(x)[a;b]
 			Data() {};
-			Data(Real const& x, Real const& y, Real const& area = 0)
+			Data(Real const& x, Value const& y, Value const& area = 0)
 				: x(x), y(y), area(area) {
 			};
 		};
@@ -110,7 +245,7 @@ namespace Quadrature
 		// Simpson's rule, three point area approximation
 		// A3,j = (b-a)(g0 + 4g2 + g4)/(3*2^(n+1))
 		auto evaluate = [](
-			std::function<Real(Real)> function,
+			Function const& function,
 			Data const& start,
 			Data const& end
 			) -> Data
@@ -118,19 +253,19 @@ namespace Quadrature
 			Data middle;
 			middle.x = (start.x + end.x) / 2;
 			middle.y = function(middle.x);
-			middle.area = std::abs(end.x - start.x) * (start.y + 4 * middle.y + end.y) / 6;
+			middle.area = std::abs(end.x - start.x) * (start.y + Real(4) * middle.y + end.y) / Real(6);
 			return middle;
 		};
 
 		auto recursive = [&evaluate, &max_depth](
 			// Self reference, needed for recursion, C++23
 			this auto const& meta,
-			std::function<Real(Real)> const& function,
+			Function const& function,
 			Data const& start,
 			Data const& middle, // A3,j = A[0]
 			Data const& end,
 			Real const& epsilon,
-			uint8_t depth) -> Real
+			uint8_t depth) -> Value
 		{
 			if ((epsilon < numeric_epsilon) || (std::abs(end.x - start.x) < numeric_interval))
 				return middle.area;
@@ -146,8 +281,8 @@ namespace Quadrature
 			auto const left = evaluate(function, start, middle);
 			auto const right = evaluate(function, middle, end);
 
-			if (!std::isfinite(left.y) || !std::isfinite(right.y))
-				return NaN;
+			if (!IsFinite(left.y) || !IsFinite(right.y))
+				return Value(NaN);
 
 			// | (A5,j-A3,j)/A5,j | <= epsilon / 2^n
 			// Estimated error
@@ -158,8 +293,8 @@ namespace Quadrature
 			// J. N. Lyness
 			// Notes on the Adaptive Simpson Quadrature Routine
 			// Estimated error using modification 1 and 2
-			Real const error = (left.area + right.area - middle.area) / 15;
-			if ((std::abs(error) < epsilon) || (++depth > max_depth))
+			Value const error = (left.area + right.area - middle.area) / Real(15);
+			if ((Magnitude(error) < epsilon) || (++depth > max_depth))
 				return left.area + right.area + error;
 
 			return meta(function, start, left, middle, epsilon / 2, depth) +
@@ -170,16 +305,21 @@ namespace Quadrature
 		Data const end(b, function(b));
 		Data const middle = evaluate(function, start, end);
 
-		if (!std::isfinite(start.y) || !std::isfinite(end.y) || !std::isfinite(middle.y))
-			return NaN;
+		if (!IsFinite(start.y) || !IsFinite(end.y) || !IsFinite(middle.y))
+			return Value(NaN);
 
 		return recursive(function, start, middle, end, epsilon, 0);
 	};
 
 	// Adaptive Quadrature - Revisited
 	// Walter Gander, Walter Gautschi
-	Real Lobatto(
-		std::function<Real(Real)> const& function,
+	//
+	// Error is the sum of |Kronrod - Lobatto| over the accepted intervals.
+	// Complex integrands share one set of intervals, tested on the modulus.
+	template <typename Function, typename Value = ValueOf<Function>>
+		requires std::invocable<Function const&, Real>
+	Result<Value> LobattoResult(
+		Function const& function,
 		Real a,
 		Real b,
 		Real const& a_epsilon = 1e-10,
@@ -199,20 +339,22 @@ namespace Quadrature
 		struct Data
 		{
 			Real x{ 0 };
-			Real y{ 0 }; // f(x)
+			Value y{ 0 }; // f(x)
 			Data() {};
-			Data(Real const& x, Real const& y = 0)
+			Data(Real const& x, Value const& y = 0)
 				: x(x), y(y) {
 			};
 		};
 
+		Result<Value> result;
+
 		auto recursive = [&](
 			// Self reference, needed for recursion, C++23
 			this auto const& meta,
-			std::function<Real(Real)> const& function,
+			Function const& function,
 			Data const& start, // point 1
 			Data const& end, // point 7
-			uint8_t depth) -> Real
+			uint8_t depth) -> Value
 		{
 			Real const h = (end.x - start.x) / 2;
 
@@ -228,40 +370,73 @@ namespace Quadrature
 			p4.y = function(p4.x);
 			p5.y = function(p5.x);
 			p6.y = function(p6.x);
+			result.evaluations += 5;
 
 			// Seven point area approximation
-			Real const area_kronrod = (h / 1470) *
-				((start.y + end.y) * 77 + (p2.y + p6.y) * 432 + (p3.y + p5.y) * 625 + p4.y * 672);
+			Value const area_kronrod = (h / 1470) *
+				((start.y + end.y) * Real(77) + (p2.y + p6.y) * Real(432) + (p3.y + p5.y) * Real(625) + p4.y * Real(672));
 
-			if (!std::isfinite(area_kronrod))
-				return NaN;
-
-			if ((std::abs(h) < numeric_interval) || (++depth > max_depth))
-				return area_kronrod;
+			if (!IsFinite(area_kronrod))
+				return Value(NaN);
 
 			// Four point area approximation
-			Real const area_lobatto = (h / 6) * (start.y + end.y + (p3.y + p5.y) * 5);
+			Value const area_lobatto = (h / 6) * (start.y + end.y + (p3.y + p5.y) * Real(5));
 
 			// Error estimate
-			if (std::abs(area_kronrod - area_lobatto) < epsilon)
+			Real const error = Magnitude(area_kronrod - area_lobatto);
+
+			if ((std::abs(h) < numeric_interval) || (++depth > max_depth))
+			{
+				result.error += error;
+				if (error >= epsilon)
+					result.status = Status::limit;
 				return area_kronrod;
+			}
 
-			return meta(function, start, p2, depth) +
-				meta(function, p2, p3, depth) +
-				meta(function, p3, p4, depth) +
-				meta(function, p4, p5, depth) +
-				meta(function, p5, p6, depth) +
-				meta(function, p6, end, depth);
+			if (error < epsilon)
+			{
+				result.error += error;
+				return area_kronrod;
+			}
+
+			// Sequenced, the operands of + may be evaluated in any order, and each adds its error
+			Value area = meta(function, start, p2, depth);
+			area += meta(function, p2, p3, depth);
+			area += meta(function, p3, p4, depth);
+			area += meta(function, p4, p5, depth);
+			area += meta(function, p5, p6, depth);
+			area += meta(function, p6, end, depth);
+			return area;
 
 		};
 
 		Data const start(a, function(a));
 		Data const end(b, function(b));
+		result.evaluations = 2;
 
-		if (!std::isfinite(start.y) || !std::isfinite(end.y))
-			return NaN;
+		if (!IsFinite(start.y) || !IsFinite(end.y))
+		{
+			result.value = Value(NaN);
+			result.status = Status::not_finite;
+			return result;
+		}
+
+		result.value = recursive(function, start, end, 0);
+		if (!IsFinite(result.value))
+			result.status = Status::not_finite;
+		return result;
+	};
 
-		return recursive(function, start, end, 0);
+	template <typename Function, typename Value = ValueOf<Function>>
+		requires std::invocable<Function const&, Real>
+	Value Lobatto(
+		Function const& function,
+		Real a,
+		Real b,
+		Real const& a_epsilon = 1e-10,
+		uint8_t const& a_max_depth = 2)
+	{
+		return LobattoResult(function, a, b, a_epsilon, a_max_depth).value;
 	};
 
 };
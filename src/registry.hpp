@@ -0,0 +1,70 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <span>
+#include <string>
+
+#include "./quadrature.hpp"
+
+// Integrands by name, for services which receive jobs rather than code
+namespace Quadrature
+{
+	// Fills y[i] = f(x[i]), called with many abscissae at once,
+	// possibly from several threads
+	using Batch = std::function<void(std::span<Real const> x, std::span<Real> y)>;
+
+	class Registry
+	{
+	public:
+		// Replaces an integrand of the same name
+		void Add(
+			std::string const& name,
+			Batch batch)
+		{
+			entries[name] = std::move(batch);
+		};
+
+		// Null if there is no such integrand
+		Batch const* Find(std::string const& name) const
+		{
+			auto const entry = entries.find(name);
+			return (entry == entries.end()) ? nullptr : &entry->second;
+		};
+
+		// Batch from a scalar function
+		template <typename Function>
+			requires std::invocable<Function const&, Real>
+		void Add(
+			std::string const& name,
+			Function const& function)
+		{
+			Add(name, Batch([function](std::span<Real const> x, std::span<Real> y)
+				{
+					for (std::size_t i{ 0 };i < x.size();++i)
+						y[i] = function(x[i]);
+				}));
+		};
+
+	private:
+		std::map<std::string, Batch> entries;
+	};
+
+};
@@ -0,0 +1,384 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <limits>
+#include <map>
+#include <span>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./panel.hpp"
+
+// Reverse communication, the caller evaluates the integrand,
+// for integrands which are not a C++ callable (another process, a remote pool, an event loop)
+namespace Quadrature
+{
+	// Lobatto rule (as LobattoResult) as a state machine,
+	// one level of intervals per step:
+	//
+	//	ReverseLobatto machine(a, b);
+	//	while (!machine.Done())
+	//	{
+	//		std::span<Real const> x = machine.Request();
+	//		... values[i] = f(x[i]) ...
+	//		machine.Supply(values);
+	//	}
+	//	Result<Real> result = machine.Outcome();
+	//
+	// The abscissae of a step may be evaluated in any order, or concurrently.
+	// Areas and errors are summed once done, depth first as the recursion of LobattoResult,
+	// the outcome is that of LobattoResult bit for bit, whatever the order of evaluation.
+	//
+	// With speculation, a step also requests the nodes of the children of its intervals,
+	// 'speculation' levels deep, before their parents are tested. Children of a failed parent
+	// are then tested in the same step, saving a round trip per level.
+	// At most 'budget' speculative abscissae are requested in total, whether used or not,
+	// and all are counted as evaluations.
+	template <typename Value = Real>
+	class ReverseLobatto
+	{
+	public:
+		ReverseLobatto(
+			Real const& a,
+			Real const& b,
+			Real const& a_epsilon = 1e-10,
+			uint8_t const& a_max_depth = 2,
+			uint8_t const& a_speculation = 0,
+			std::size_t const a_budget = std::numeric_limits<std::size_t>::max())
+		{
+			Reset(a, b, a_epsilon, a_max_depth, a_speculation, a_budget);
+		};
+
+		// Starts another integral, keeping the memory of the last
+		void Reset(
+			Real a,
+			Real b,
+			Real const& a_epsilon = 1e-10,
+			uint8_t const& a_max_depth = 2,
+			uint8_t const& a_speculation = 0,
+			std::size_t const a_budget = std::numeric_limits<std::size_t>::max())
+		{
+			max_depth = std::min(a_max_depth, static_cast<uint8_t>(8));
+			speculation = std::min(a_speculation, max_depth);
+			budget = a_budget;
+			epsilon = std::max(a_epsilon, numeric_epsilon);
+			result = {};
+			level.clear();
+			tree.clear();
+			prefetched.clear();
+
+			if (b < a)
+				std::swap(a, b);
+
+			// The ends first, the interval follows once their values are known
+			request.assign({ a, b });
+		};
+
+		bool Done() const
+		{
+			return request.empty();
+		};
+
+		// Abscissae to evaluate next, valid until Supply
+		std::span<Real const> Request() const
+		{
+			return request;
+		};
+
+		// Integrand values at the requested abscissae, in the same order
+		void Supply(std::span<Value const> values)
+		{
+			if (Done())
+				return;
+			if (values.size() != request.size())
+			{
+				Stop(Status::invalid);
+				return;
+			}
+			result.evaluations += values.size();
+
+			if (level.empty())
+			{
+				if (!IsFinite(values[0]) || !IsFinite(values[1]))
+				{
+					Stop(Status::not_finite);
+					return;
+				}
+				level.push_back({ request[0], request[1], values[0], values[1], 0, 0 });
+				tree.assign(1, Node{});
+				Prepare();
+				return;
+			}
+
+			// Requested intervals first, then the speculative nodes
+			std::size_t const requested = 5 * level.size();
+			prefetched.clear();
+			for (std::size_t i{ requested };i < request.size();++i)
+				prefetched.emplace(request[i], values[i]);
+
+			next.clear();
+			ready.clear();
+			for (std::size_t p{ 0 };p < level.size();++p)
+			{
+				std::array<Real, 5> x;
+				std::array<Value, 5> v;
+				std::copy_n(&request[5 * p], 5, x.begin());
+				std::copy_n(&values[5 * p], 5, v.begin());
+				if (!Test(level[p], x, v))
+					return;
+
+				// Children with all nodes prefetched
+				while (!ready.empty())
+				{
+					Panel const panel = ready.back();
+					ready.pop_back();
+					x = Nodes(panel);
+					for (std::size_t i{ 0 };i < 5;++i)
+						v[i] = prefetched.find(x[i])->second;
+					if (!Test(panel, x, v))
+						return;
+				};
+			};
+
+			// Both hold the largest level, which of them holds a level changes from one integral to the next
+			std::swap(level, next);
+			if (next.capacity() < level.capacity())
+				next.reserve(level.capacity());
+			if (level.empty())
+				Reduce();
+			Prepare();
+		};
+
+		Result<Value> const& Outcome() const
+		{
+			return result;
+		};
+
+	private:
+		// Interval waiting for the values between its ends
+		struct Panel
+		{
+			Real start;
+			Real end;
+			Value y_start; // f(start)
+			Value y_end; // f(end)
+			uint8_t depth;
+			std::size_t node; // In tree
+		};
+
+		// Accepted interval, or one split in six
+		struct Node
+		{
+			Value area{ 0 };
+			Real error{ 0 };
+			std::size_t children{ 0 }; // First of six consecutive nodes, 0 if accepted
+		};
+
+		uint8_t max_depth;
+		uint8_t speculation;
+		std::size_t budget;
+		Real epsilon;
+
+		std::vector<Panel> level;
+		std::vector<Panel> next;
+		std::vector<Panel> ready;
+		std::vector<Panel> frontier;
+		std::vector<Panel> children;
+		std::vector<Node> tree; // Root first
+		std::vector<Real> request;
+		std::map<Real, Value> prefetched;
+		Result<Value> result;
+
+		// Lobatto and Kronrod points between the ends of an interval
+		static std::array<Real, 5> Nodes(Panel const& panel)
+		{
+			Real static const node_lobatto = std::sqrt(Real(1) / Real(5));
+			Real static const node_kronrod = std::sqrt(Real(2) / Real(3));
+
+			Real const h = (panel.end - panel.start) / 2;
+			Real const middle = (panel.start + panel.end) / 2;
+			return { middle - node_kronrod * h, middle - node_lobatto * h, middle,
+				middle + node_lobatto * h, middle + node_kronrod * h };
+		};
+
+		// Whether the interval is split if its error is too large
+		bool Splits(Panel const& panel) const
+		{
+			return (std::abs(panel.end - panel.start) / 2 >= numeric_interval) && (panel.depth + 1 <= max_depth);
+		};
+
+		// Accept the interval, or queue its children,
+		// false if the integrand was not finite
+		bool Test(
+			Panel const& panel,
+			std::array<Real, 5> const& x,
+			std::array<Value, 5> const& v)
+		{
+			std::array<Value, 7> const y{ panel.y_start, v[0], v[1], v[2], v[3], v[4], panel.y_end };
+			Real const h = (panel.end - panel.start) / 2;
+
+			// Seven point area approximation
+			Value const area_kronrod = (h / 1470) *
+				((y[0] + y[6]) * Real(77) + (y[1] + y[5]) * Real(432) + (y[2] + y[4]) * Real(625) + y[3] * Real(672));
+
+			if (!IsFinite(area_kronrod))
+			{
+				Stop(Status::not_finite);
+				return false;
+			}
+
+			// Four point area approximation
+			Value const area_lobatto = (h / 6) * (y[0] + y[6] + (y[2] + y[4]) * Real(5));
+
+			// Error estimate
+			Real const error = Magnitude(area_kronrod - area_lobatto);
+
+			bool const limit = !Splits(panel);
+			if (limit || (error < epsilon))
+			{
+				tree[panel.node].area = area_kronrod;
+				tree[panel.node].error = error;
+				if (limit && (error >= epsilon))
+					result.status = Status::limit;
+				return true;
+			}
+
+			std::array<Real, 7> const edge{ panel.start, x[0], x[1], x[2], x[3], x[4], panel.end };
+			uint8_t const depth = panel.depth + 1;
+			std::size_t const first = tree.size();
+			tree.resize(first + 6);
+			tree[panel.node].children = first;
+			for (std::size_t i{ 0 };i < 6;++i)
+			{
+				Panel const child{ edge[i], edge[i + 1], y[i], y[i + 1], depth, first + i };
+				if (prefetched.contains(Nodes(child)[0]))
+					ready.push_back(child);
+				else
+					next.push_back(child);
+			};
+			return true;
+		};
+
+		// Nodes of the waiting intervals, and of their descendants while speculating
+		void Prepare()
+		{
+			request.clear();
+			for (Panel const& panel : level)
+			{
+				std::array<Real, 5> const x = Nodes(panel);
+				request.insert(request.end(), x.begin(), x.end());
+			};
+
+			if (!speculation)
+				return;
+			frontier.assign(level.begin(), level.end());
+			for (uint8_t s{ 0 };s < speculation;++s)
+			{
+				children.clear();
+				for (Panel const& panel : frontier)
+				{
+					if (!Splits(panel))
+						continue;
+					std::array<Real, 5> const x = Nodes(panel);
+					std::array<Real, 7> const edge{ panel.start, x[0], x[1], x[2], x[3], x[4], panel.end };
+					for (std::size_t i{ 0 };i < 6;++i)
+					{
+						if (budget < 5)
+							return;
+						budget -= 5;
+						Panel const child{ edge[i], edge[i + 1], Value{ 0 }, Value{ 0 }, static_cast<uint8_t>(panel.depth + 1), 0 };
+						std::array<Real, 5> const nodes = Nodes(child);
+						request.insert(request.end(), nodes.begin(), nodes.end());
+						children.push_back(child);
+					};
+				};
+				std::swap(frontier, children);
+			};
+		};
+
+		// Value and error of the tree, in the order of the recursion of LobattoResult
+		void Reduce()
+		{
+			auto sum = [this](
+				// Self reference, needed for recursion, C++23
+				this auto const& meta,
+				std::size_t const index) -> Value
+			{
+				Node const& node = tree[index];
+				if (!node.children)
+				{
+					result.error += node.error;
+					return node.area;
+				}
+				// One child after the other, the errors are added in this order
+				Value area = meta(node.children);
+				for (std::size_t i{ 1 };i < 6;++i)
+					area += meta(node.children + i);
+				return area;
+			};
+			result.value = sum(0);
+		};
+
+		void Stop(Status const status)
+		{
+			result.value = Value(NaN);
+			result.status = status;
+			level.clear();
+			request.clear();
+		};
+	};
+
+	// LobattoResult for a batch integrand, integrand(x, y) fills y[i] = f(x[i]),
+	// called once per level of intervals
+	template <typename Integrand>
+		requires std::invocable<Integrand const&, std::span<Real const>, std::span<Real>>
+	Result<Real> LobattoBatch(
+		Integrand const& integrand,
+		Real a,
+		Real b,
+		Real const& a_epsilon = 1e-10,
+		uint8_t const& a_max_depth = 2)
+	{
+		// Machine and values of this thread, kept between calls
+		struct Workspace
+		{
+			ReverseLobatto<Real> machine{ 0, 0 };
+			std::vector<Real> values;
+			void Clear() {};
+		};
+		Lease<Workspace> workspace;
+		ReverseLobatto<Real>& machine = workspace->machine;
+		std::vector<Real>& values = workspace->values;
+
+		machine.Reset(a, b, a_epsilon, a_max_depth);
+		while (!machine.Done())
+		{
+			std::span<Real const> const x = machine.Request();
+			values.resize(x.size());
+			integrand(x, std::span<Real>(values));
+			machine.Supply(values);
+		};
+		return machine.Outcome();
+	};
+
+};
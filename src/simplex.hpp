@@ -0,0 +1,342 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./pool.hpp"
+
+// Fixed symmetric rules for triangles and tetrahedra,
+// applied to many mesh elements at once
+namespace Quadrature
+{
+	// Quadrature node in barycentric coordinates,
+	// weights are normalised to a unit area/volume
+	template <std::size_t Vertices>
+	struct Node
+	{
+		std::array<Real, Vertices> barycentric;
+		Real weight;
+	};
+
+	// Number of nodes of a rule, from its orbits.
+	// Each orbit is one node, standing for all distinct permutations of its coordinates.
+	template <std::size_t Vertices, std::size_t Orbits>
+	constexpr std::size_t Points(std::array<Node<Vertices>, Orbits> const& orbits)
+	{
+		std::size_t count{ 0 };
+		for (Node<Vertices> const& orbit : orbits)
+		{
+			std::array<Real, Vertices> c = orbit.barycentric;
+			std::sort(c.begin(), c.end());
+			do
+				++count;
+			while (std::next_permutation(c.begin(), c.end()));
+		};
+		return count;
+	};
+
+	template <std::size_t Count, std::size_t Vertices, std::size_t Orbits>
+	constexpr std::array<Node<Vertices>, Count> Expand(std::array<Node<Vertices>, Orbits> const& orbits)
+	{
+		std::array<Node<Vertices>, Count> nodes{};
+		std::size_t count{ 0 };
+		for (Node<Vertices> const& orbit : orbits)
+		{
+			std::array<Real, Vertices> c = orbit.barycentric;
+			std::sort(c.begin(), c.end());
+			do
+				nodes[count++] = { c, orbit.weight };
+			while (std::next_permutation(c.begin(), c.end()));
+		};
+		return nodes;
+	};
+
+	namespace Rule
+	{
+		constexpr Real third = Real(1) / 3;
+		constexpr Real sixth = Real(1) / 6;
+
+		// High Degree Efficient Symmetrical Gaussian Quadrature Rules for the Triangle
+		// D. A. Dunavant
+		//
+		// Degrees 4 to 6 are listed to 36 digits, enough for binary128. Those of degrees 4 and 6,
+		// tabulated to 15 digits in the paper, are refined by Newton's method on their moment equations.
+		constexpr std::array<Node<3>, 1> triangle_1_orbits{ {
+			{ { third, third, third }, 1 }
+		} };
+		constexpr std::array<Node<3>, 1> triangle_2_orbits{ {
+			{ { Real(2) / 3, sixth, sixth }, third }
+		} };
+		constexpr std::array<Node<3>, 2> triangle_3_orbits{ {
+			{ { third, third, third }, Real(-27) / 48 },
+			{ { Real(3) / 5, Real(1) / 5, Real(1) / 5 }, Real(25) / 48 }
+		} };
+		constexpr std::array<Node<3>, 2> triangle_4_orbits{ {
+			{ { 0.108103018168070227363341492233896023q, 0.445948490915964886318329253883051988q,
+				0.445948490915964886318329253883051988q }, 0.223381589678011465695007008433122804q },
+			{ { 0.816847572980458513080857073195596984q, 0.0915762135097707434595714634022015078q,
+				0.0915762135097707434595714634022015078q }, 0.109951743655321867638326324900210529q }
+		} };
+		constexpr std::array<Node<3>, 3> triangle_5_orbits{ {
+			{ { third, third, third }, Real(9) / 40 },
+			{ { 0.0597158717897698204591175809731047990q, 0.470142064105115089770441209513447601q,
+				0.470142064105115089770441209513447601q }, 0.132394152788506180737649387833152000q },
+			{ { 0.797426985353087322398025276169752344q, 0.101286507323456338800987361915123828q,
+				0.101286507323456338800987361915123828q }, 0.125939180544827152595683945500181334q }
+		} };
+		constexpr std::array<Node<3>, 3> triangle_6_orbits{ {
+			{ { 0.501426509658179157416722893785961848q, 0.249286745170910421291638553107019076q,
+				0.249286745170910421291638553107019076q }, 0.116786275726379366025289611385579441q },
+			{ { 0.873821971016995543319336794258361685q, 0.0630890144915022283403316028708191573q,
+				0.0630890144915022283403316028708191573q }, 0.0508449063702068169209368091068689840q },
+			{ { 0.0531450498448169473532496716313981470q, 0.310352451033784405416607733956552153q,
+				0.636502499121398647230142594412049700q }, 0.0828510756183735751935534564204424540q }
+		} };
+
+		// Reducing the number of points in cubature formulae for the tetrahedron
+		// P. Keast
+		constexpr std::array<Node<4>, 1> tetrahedron_1_orbits{ {
+			{ { Real(1) / 4, Real(1) / 4, Real(1) / 4, Real(1) / 4 }, 1 }
+		} };
+		constexpr std::array<Node<4>, 1> tetrahedron_2_orbits{ {
+			{ { 0.585410196624968454461376050309691435q, 0.138196601125010515179541316563436188q,
+				0.138196601125010515179541316563436188q, 0.138196601125010515179541316563436188q }, Real(1) / 4 }
+		} };
+		constexpr std::array<Node<4>, 2> tetrahedron_3_orbits{ {
+			{ { Real(1) / 4, Real(1) / 4, Real(1) / 4, Real(1) / 4 }, Real(-4) / 5 },
+			{ { Real(1) / 2, sixth, sixth, sixth }, Real(9) / 20 }
+		} };
+		constexpr std::array<Node<4>, 3> tetrahedron_4_orbits{ {
+			{ { Real(1) / 4, Real(1) / 4, Real(1) / 4, Real(1) / 4 }, Real(-444) / 5625 },
+			{ { Real(11) / 14, Real(1) / 14, Real(1) / 14, Real(1) / 14 }, Real(343) / 7500 },
+			{ { 0.399403576166799204996102147461640623q, 0.399403576166799204996102147461640623q,
+				0.100596423833200795003897852538359377q, 0.100596423833200795003897852538359377q }, Real(56) / 375 }
+		} };
+
+		constexpr auto triangle_1 = Expand<Points(triangle_1_orbits)>(triangle_1_orbits);
+		constexpr auto triangle_2 = Expand<Points(triangle_2_orbits)>(triangle_2_orbits);
+		constexpr auto triangle_3 = Expand<Points(triangle_3_orbits)>(triangle_3_orbits);
+		constexpr auto triangle_4 = Expand<Points(triangle_4_orbits)>(triangle_4_orbits);
+		constexpr auto triangle_5 = Expand<Points(triangle_5_orbits)>(triangle_5_orbits);
+		constexpr auto triangle_6 = Expand<Points(triangle_6_orbits)>(triangle_6_orbits);
+
+		constexpr auto tetrahedron_1 = Expand<Points(tetrahedron_1_orbits)>(tetrahedron_1_orbits);
+		constexpr auto tetrahedron_2 = Expand<Points(tetrahedron_2_orbits)>(tetrahedron_2_orbits);
+		constexpr auto tetrahedron_3 = Expand<Points(tetrahedron_3_orbits)>(tetrahedron_3_orbits);
+		constexpr auto tetrahedron_4 = Expand<Points(tetrahedron_4_orbits)>(tetrahedron_4_orbits);
+
+		// Lowest degree rule exact for polynomials of 'degree',
+		// empty if no rule is available
+		std::span<Node<3> const> Triangle(uint8_t const& degree)
+		{
+			switch (degree)
+			{
+			case 0:
+			case 1: return triangle_1;
+			case 2: return triangle_2;
+			case 3: return triangle_3;
+			case 4: return triangle_4;
+			case 5: return triangle_5;
+			case 6: return triangle_6;
+			default: return {};
+			};
+		};
+
+		std::span<Node<4> const> Tetrahedron(uint8_t const& degree)
+		{
+			switch (degree)
+			{
+			case 0:
+			case 1: return tetrahedron_1;
+			case 2: return tetrahedron_2;
+			case 3: return tetrahedron_3;
+			case 4: return tetrahedron_4;
+			default: return {};
+			};
+		};
+	};
+
+	// Mesh elements, structure of arrays: x[k][e] is the x coordinate of vertex k of element e
+	template <typename T = Real>
+	struct Triangles
+	{
+		std::array<std::span<T const>, 3> x;
+		std::array<std::span<T const>, 3> y;
+	};
+
+	template <typename T = Real>
+	struct Tetrahedra
+	{
+		std::array<std::span<T const>, 4> x;
+		std::array<std::span<T const>, 4> y;
+		std::array<std::span<T const>, 4> z;
+	};
+
+	namespace Detail
+	{
+		// Integral over every element, in blocks of elements taken by the threads.
+		// For each node of the rule, the mapped points of a whole block are passed
+		// to the integrand, so both the mapping and the integrand loop over contiguous arrays.
+		template <std::size_t Vertices, typename T, typename Integrand>
+		Status Elements(
+			Integrand const& integrand,
+			std::array<std::array<std::span<T const>, Vertices>, Vertices - 1> const& coordinates,
+			std::span<Node<Vertices> const> rule,
+			std::span<T> integrals,
+			unsigned const a_threads)
+		{
+			constexpr std::size_t dimensions = Vertices - 1;
+			constexpr std::size_t block{ 256 };
+
+			std::size_t const elements = integrals.size();
+			bool valid = !rule.empty();
+			for (auto const& axis : coordinates)
+				for (auto const& vertex : axis)
+					if (vertex.size() < elements)
+						valid = false;
+
+			if (!valid)
+			{
+				std::fill(integrals.begin(), integrals.end(), static_cast<T>(NaN));
+				return Status::invalid;
+			}
+
+			std::size_t const blocks = (elements + block - 1) / block;
+			unsigned const participants = std::min<std::size_t>(std::max(a_threads, 1u), blocks);
+			WorkIndices indices(blocks, participants);
+			std::atomic<bool> finite{ true };
+
+			// Factorial of the dimension, unit simplex volume is 1/dimensions!
+			T const simplex = (dimensions == 2) ? T(1) / 2 : T(1) / 6;
+
+			auto worker = [&]()
+			{
+				std::array<std::array<T, block>, dimensions> point;
+				std::array<T, block> value;
+				std::array<T, block> sum;
+				std::array<T, block> volume;
+
+				for (std::size_t k = indices.Next();k < blocks;k = indices.Next())
+				{
+					std::size_t const first = k * block;
+					std::size_t const count = std::min(block, elements - first);
+
+					// Jacobian determinant, edges from vertex 0
+					for (std::size_t e{ 0 };e < count;++e)
+					{
+						auto edge = [&](std::size_t const& axis, std::size_t const& vertex) -> T
+						{
+							return coordinates[axis][vertex][first + e] - coordinates[axis][0][first + e];
+						};
+						T determinant;
+						if constexpr (dimensions == 2)
+							determinant = edge(0, 1) * edge(1, 2) - edge(0, 2) * edge(1, 1);
+						else
+							determinant =
+								edge(0, 1) * (edge(1, 2) * edge(2, 3) - edge(1, 3) * edge(2, 2)) -
+								edge(0, 2) * (edge(1, 1) * edge(2, 3) - edge(1, 3) * edge(2, 1)) +
+								edge(0, 3) * (edge(1, 1) * edge(2, 2) - edge(1, 2) * edge(2, 1));
+						volume[e] = std::abs(determinant) * simplex;
+						sum[e] = 0;
+					};
+
+					for (Node<Vertices> const& node : rule)
+					{
+						for (std::size_t axis{ 0 };axis < dimensions;++axis)
+						{
+							T* p = point[axis].data();
+							for (std::size_t e{ 0 };e < count;++e)
+								p[e] = 0;
+							for (std::size_t vertex{ 0 };vertex < Vertices;++vertex)
+							{
+								T const l = static_cast<T>(node.barycentric[vertex]);
+								T const* c = coordinates[axis][vertex].data() + first;
+								for (std::size_t e{ 0 };e < count;++e)
+									p[e] += l * c[e];
+							};
+						};
+
+						std::span<T> values(value.data(), count);
+						if constexpr (dimensions == 2)
+							integrand(std::span<T const>(point[0].data(), count),
+								std::span<T const>(point[1].data(), count), values);
+						else
+							integrand(std::span<T const>(point[0].data(), count),
+								std::span<T const>(point[1].data(), count),
+								std::span<T const>(point[2].data(), count), values);
+
+						T const w = static_cast<T>(node.weight);
+						for (std::size_t e{ 0 };e < count;++e)
+							sum[e] += w * value[e];
+					};
+
+					for (std::size_t e{ 0 };e < count;++e)
+					{
+						integrals[first + e] = sum[e] * volume[e];
+						if (!std::isfinite(integrals[first + e]))
+							finite = false;
+					};
+				};
+			};
+
+			ThreadPool::Instance().Run(participants, worker);
+
+			return finite ? Status::converged : Status::not_finite;
+		};
+	};
+
+	// Integral over each triangle, exact for polynomials up to 'degree' (at most 6).
+	// The integrand is called per rule node, for a block of elements:
+	//   void integrand(std::span<T const> x, std::span<T const> y, std::span<T> values)
+	//
+	// Elements with a non finite integral are reported by Status::not_finite,
+	// all integrals are NaN if the degree is not available or the vertices are fewer than the integrals.
+	template <typename T, typename Integrand>
+	Status Integrate(
+		Integrand const& integrand,
+		Triangles<T> const& mesh,
+		std::span<T> integrals,
+		uint8_t const& degree = 4,
+		unsigned const threads = std::thread::hardware_concurrency())
+	{
+		return Detail::Elements<3, T>(integrand, { mesh.x, mesh.y }, Rule::Triangle(degree), integrals, threads);
+	};
+
+	// Integral over each tetrahedron, exact for polynomials up to 'degree' (at most 4).
+	//   void integrand(std::span<T const> x, std::span<T const> y, std::span<T const> z, std::span<T> values)
+	template <typename T, typename Integrand>
+	Status Integrate(
+		Integrand const& integrand,
+		Tetrahedra<T> const& mesh,
+		std::span<T> integrals,
+		uint8_t const& degree = 4,
+		unsigned const threads = std::thread::hardware_concurrency())
+	{
+		return Detail::Elements<4, T>(integrand, { mesh.x, mesh.y, mesh.z }, Rule::Tetrahedron(degree), integrals, threads);
+	};
+
+};
@@ -0,0 +1,413 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <concepts>
+#include <cstdint>
+#include <queue>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "./quadrature.hpp"
+
+// Sparse grid integration over a hyperrectangle [a;b],
+// for smooth integrands in moderate dimensions
+namespace Quadrature
+{
+	namespace Detail
+	{
+		// Clenshaw-Curtis weights on [-1;1] of m = 2^k + 1 points, by an inverse FFT of length m - 1
+		// Fast Construction of the Fejer and Clenshaw-Curtis Quadrature Rules
+		// J. Waldvogel
+		std::vector<Real> ClenshawCurtis(std::size_t const m)
+		{
+			if (m == 1)
+				return { 2 };
+			std::size_t const n = m - 1;
+			std::size_t const half = n / 2;
+
+			// Moments, v0 has n + 1 entries: 2 / (k (k - 2)) for odd k < n, then 1 / (n - 1), then zeros
+			auto v0 = [&](std::size_t const& i) -> Real
+			{
+				if (i < half)
+				{
+					Real const k = 2 * Real(i) + 1;
+					return 2 / (k * (k - 2));
+				}
+				return (i == half) ? 1 / Real(n - 1) : Real(0);
+			};
+
+			std::vector<std::complex<Real>> c(n);
+			Real const scale = Real(n) * Real(n) - 1;
+			for (std::size_t i{ 0 };i < n;++i)
+			{
+				Real g = -1;
+				if (i == half)
+					g += 2 * Real(n);
+				c[i] = -v0(i) - v0(n - i) + g / scale;
+			};
+
+			// Bit reversal, then radix 2 butterflies, sign of the inverse transform
+			for (std::size_t i{ 1 }, j{ 0 };i < n;++i)
+			{
+				std::size_t bit = n >> 1;
+				for (;j & bit;bit >>= 1)
+					j ^= bit;
+				j ^= bit;
+				if (i < j)
+					std::swap(c[i], c[j]);
+			};
+			std::vector<std::complex<Real>> twiddle(half);
+			for (std::size_t k{ 0 };k < half;++k)
+				twiddle[k] = { std::cos(2 * pi * k / n), std::sin(2 * pi * k / n) };
+			for (std::size_t length{ 2 };length <= n;length <<= 1)
+			{
+				std::size_t const stride = n / length;
+				for (std::size_t first{ 0 };first < n;first += length)
+					for (std::size_t k{ 0 };k < length / 2;++k)
+					{
+						std::complex<Real> const t = twiddle[k * stride] * c[first + k + length / 2];
+						c[first + k + length / 2] = c[first + k] - t;
+						c[first + k] += t;
+					};
+			};
+
+			std::vector<Real> w(m);
+			for (std::size_t j{ 0 };j < n;++j)
+				w[j] = c[j].real() / n;
+			w[n] = w[0];
+			return w;
+		};
+	};
+
+	// Dimension-Adaptive Tensor-Product Quadrature
+	// T. Gerstner, M. Griebel
+	//
+	// Smolyak combination of nested Clenshaw-Curtis rules, 1, 3, 5, 9, 17, ... points.
+	// The multi-index with the largest difference contribution is refined,
+	// so dimensions which matter get higher levels.
+	//
+	// Points are identified by the position of their nodes on the finest 1D grid,
+	// and each is evaluated once. The new points of all indices added in a step
+	// are passed to the integrand in one batch (point major, d per point):
+	//   void integrand(std::span<Real const> points, std::span<Real> values)
+	//
+	// Error is the sum of the contributions of the indices not yet refined.
+	template <typename Integrand>
+		requires std::invocable<Integrand const&, std::span<Real const>, std::span<Real>>
+	Result<Real> SparseGrid(
+		Integrand const& integrand,
+		std::span<Real const> a,
+		std::span<Real const> b,
+		Real const& a_epsilon = 1e-10,
+		std::size_t const max_evaluations = 1'000'000)
+	{
+		Result<Real> result;
+
+		std::size_t const d = a.size();
+		if (!d || (b.size() != d))
+		{
+			result.value = NaN;
+			result.status = Status::invalid;
+			return result;
+		}
+
+		Real const epsilon = std::max(a_epsilon, numeric_epsilon);
+
+		// Finest 1D level, 2^24 + 1 nodes
+		constexpr uint8_t max_level{ 25 };
+
+		// Nodes and difference weights (level l minus level l-1) of a 1D level
+		struct Level
+		{
+			std::vector<uint32_t> id; // Position on the finest grid
+			std::vector<Real> node;
+			std::vector<Real> weight;
+		};
+		std::vector<Level> rule;
+
+		// Position of node 'j' of level 'l' on the finest grid
+		auto position = [](uint8_t const& l, std::size_t const& j) -> uint32_t
+		{
+			return (l == 1) ? (uint32_t(1) << (max_level - 2)) : uint32_t(j) << (max_level - l);
+		};
+		auto points = [](uint8_t const& l) -> std::size_t
+		{
+			return (l == 1) ? 1 : (std::size_t(1) << (l - 1)) + 1;
+		};
+
+		// Full weights of the last level built
+		std::vector<Real> full;
+
+		// Built on first use, after the evaluations of its grid were checked against the budget
+		auto level = [&](uint8_t const& l) -> Level const&
+		{
+			while (rule.size() < l)
+			{
+				uint8_t const current = static_cast<uint8_t>(rule.size() + 1);
+				std::size_t const m = points(current);
+				std::vector<Real> w = Detail::ClenshawCurtis(m);
+
+				Level next;
+				next.id.resize(m);
+				next.node.resize(m);
+				next.weight.resize(m);
+				for (std::size_t j{ 0 };j < m;++j)
+				{
+					next.id[j] = position(current, j);
+					next.node[j] = (m == 1) ? 0 : -std::cos(pi * j / (m - 1));
+					next.weight[j] = w[j];
+				};
+
+				// Nested, node j of the previous level is node 2 j here (the middle node of level 1)
+				for (std::size_t j{ 0 };j < full.size();++j)
+					next.weight[(current == 2) ? 1 : 2 * j] -= full[j];
+
+				full = std::move(w);
+				rule.push_back(std::move(next));
+			};
+			return rule[l - 1];
+		};
+
+		struct Hash
+		{
+			std::size_t operator()(std::vector<uint32_t> const& key) const
+			{
+				// FNV-1a over the node positions
+				uint64_t hash{ 0xCBF29CE484222325ull };
+				for (uint32_t const& k : key)
+					hash = (hash ^ k) * 0x100000001B3ull;
+				return static_cast<std::size_t>(hash);
+			};
+		};
+
+		// Integrand values by node positions
+		std::unordered_map<std::vector<uint32_t>, Real, Hash> cache;
+
+		// Multi-indices, looked up by their levels
+		struct Index
+		{
+			std::vector<uint32_t> levels;
+			Real delta{ 0 };
+			bool old{ false };
+		};
+		std::vector<Index> indices;
+		std::unordered_map<std::vector<uint32_t>, std::size_t, Hash> lookup;
+
+		Real scale{ 1 };
+		for (std::size_t i{ 0 };i < d;++i)
+			scale *= std::abs(b[i] - a[i]) / 2;
+
+		// Visit all points of the tensor grid of an index
+		auto tensor = [&](std::vector<uint32_t> const& levels, auto const& visit)
+		{
+			std::vector<std::size_t> cursor(d, 0);
+			std::vector<uint32_t> key(d);
+			while (true)
+			{
+				Real weight{ 1 };
+				for (std::size_t i{ 0 };i < d;++i)
+				{
+					Level const& l = level(static_cast<uint8_t>(levels[i]));
+					key[i] = l.id[cursor[i]];
+					weight *= l.weight[cursor[i]];
+				};
+				visit(key, cursor, weight);
+
+				std::size_t i{ 0 };
+				for (;i < d;++i)
+				{
+					if (++cursor[i] < level(static_cast<uint8_t>(levels[i])).id.size())
+						break;
+					cursor[i] = 0;
+				};
+				if (i == d)
+					break;
+			};
+		};
+
+		std::vector<Real> batch_points;
+		std::vector<Real> batch_values;
+		std::vector<std::vector<uint32_t>> batch_keys;
+
+		// Evaluate the points of new indices, in one batch, then their contributions
+		auto add = [&](std::vector<std::vector<uint32_t>> const& candidates) -> bool
+		{
+			batch_points.clear();
+			batch_keys.clear();
+			for (std::vector<uint32_t> const& levels : candidates)
+				tensor(levels, [&](std::vector<uint32_t> const& key, std::vector<std::size_t> const& cursor, Real const&)
+				{
+					if (cache.contains(key))
+						return;
+					cache.emplace(key, NaN);
+					batch_keys.push_back(key);
+					for (std::size_t i{ 0 };i < d;++i)
+					{
+						Real const t = level(static_cast<uint8_t>(levels[i])).node[cursor[i]];
+						batch_points.push_back((a[i] + b[i]) / 2 + (b[i] - a[i]) / 2 * t);
+					};
+				});
+
+			if (!batch_keys.empty())
+			{
+				batch_values.resize(batch_keys.size());
+				integrand(std::span<Real const>(batch_points), std::span<Real>(batch_values));
+				result.evaluations += batch_keys.size();
+				for (std::size_t p{ 0 };p < batch_keys.size();++p)
+				{
+					if (!std::isfinite(batch_values[p]))
+						return false;
+					cache[batch_keys[p]] = batch_values[p];
+				};
+			};
+
+			for (std::vector<uint32_t> const& levels : candidates)
+			{
+				Real delta{ 0 };
+				tensor(levels, [&](std::vector<uint32_t> const& key, std::vector<std::size_t> const&, Real const& weight)
+				{
+					delta += weight * cache.find(key)->second;
+				});
+				lookup.emplace(levels, indices.size());
+				indices.push_back({ levels, scale * delta, false });
+			};
+			return true;
+		};
+
+		// Active indices, largest contribution first
+		auto compare = [&indices](std::size_t const& lhs, std::size_t const& rhs) -> bool
+		{
+			return std::abs(indices[lhs].delta) < std::abs(indices[rhs].delta);
+		};
+		std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(compare)> active(compare);
+
+		if (!add({ std::vector<uint32_t>(d, 1) }))
+		{
+			result.value = NaN;
+			result.status = Status::not_finite;
+			return result;
+		}
+		active.push(0);
+		Real error = std::abs(indices[0].delta);
+
+		while (error >= epsilon)
+		{
+			std::size_t const refine = active.top();
+			active.pop();
+			indices[refine].old = true;
+			error -= std::abs(indices[refine].delta);
+
+			// Forward neighbours, admissible when all their backward neighbours are old
+			std::vector<std::vector<uint32_t>> candidates;
+			std::size_t new_points{ 0 };
+			for (std::size_t j{ 0 };j < d;++j)
+			{
+				std::vector<uint32_t> forward = indices[refine].levels;
+				if (++forward[j] > max_level)
+					continue;
+				if (lookup.contains(forward))
+					continue;
+
+				bool admissible{ true };
+				for (std::size_t i{ 0 };(i < d) && admissible;++i)
+				{
+					if (forward[i] == 1)
+						continue;
+					std::vector<uint32_t> backward = forward;
+					--backward[i];
+					auto const found = lookup.find(backward);
+					admissible = (found != lookup.end()) && indices[found->second].old;
+				};
+				if (!admissible)
+					continue;
+
+				// Saturated above the budget, the grid of high levels in many dimensions overflows
+				std::size_t grid{ 1 };
+				for (uint32_t const& l : forward)
+				{
+					std::size_t const m = points(static_cast<uint8_t>(l));
+					grid = (grid > max_evaluations / m) ? max_evaluations + 1 : grid * m;
+				};
+				new_points = std::min(new_points + grid, max_evaluations + 1);
+				candidates.push_back(std::move(forward));
+			};
+
+			// Upper bound, shared points are not counted as new.
+			// Checked before add(), which builds the levels of the candidates.
+			if (result.evaluations + new_points > max_evaluations)
+			{
+				// Keep the refined index active, for the error estimate
+				indices[refine].old = false;
+				error += std::abs(indices[refine].delta);
+				result.status = Status::limit;
+				break;
+			}
+
+			std::size_t const first = indices.size();
+			if (!add(candidates))
+			{
+				result.value = NaN;
+				result.status = Status::not_finite;
+				return result;
+			}
+			for (std::size_t k{ first };k < indices.size();++k)
+			{
+				active.push(k);
+				error += std::abs(indices[k].delta);
+			};
+
+			if (active.empty())
+				break;
+		};
+
+		// Sum afresh, rather than from the running error
+		for (Index const& index : indices)
+		{
+			result.value += index.delta;
+			if (!index.old)
+				result.error += std::abs(index.delta);
+		};
+		return result;
+	};
+
+	// Scalar integrand, evaluated one point at a time
+	//   Real function(std::span<Real const> x)
+	template <typename Function>
+		requires std::invocable<Function const&, std::span<Real const>>
+	Result<Real> SparseGrid(
+		Function const& function,
+		std::span<Real const> a,
+		std::span<Real const> b,
+		Real const& a_epsilon = 1e-10,
+		std::size_t const max_evaluations = 1'000'000)
+	{
+		std::size_t const d = a.size();
+		auto batch = [&function, &d](std::span<Real const> points, std::span<Real> values)
+		{
+			for (std::size_t i{ 0 };i < values.size();++i)
+				values[i] = function(points.subspan(i * d, d));
+		};
+		return SparseGrid(batch, a, b, a_epsilon, max_evaluations);
+	};
+
+};
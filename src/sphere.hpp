@@ -0,0 +1,327 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./quadrature.hpp"
+
+// Integration over the unit sphere S^2,
+// many integrands or rotated copies against one set of directions
+namespace Quadrature
+{
+	// Point on the unit sphere, weights are normalised to sum to 1
+	struct Direction
+	{
+		std::array<Real, 3> point;
+		Real weight;
+	};
+
+	// Number of directions of a rule, from its generators.
+	// Each generator stands for all permutations of its coordinates,
+	// with all signs of the non zero coordinates (octahedral symmetry).
+	template <std::size_t Generators>
+	constexpr std::size_t Points(std::array<Direction, Generators> const& generators)
+	{
+		std::size_t count{ 0 };
+		for (Direction const& generator : generators)
+		{
+			std::array<Real, 3> c = generator.point;
+			std::sort(c.begin(), c.end());
+			std::size_t const signs = std::size_t(1) << std::count_if(c.begin(), c.end(),
+				[](Real const& v) -> bool { return v != 0; });
+			do
+				count += signs;
+			while (std::next_permutation(c.begin(), c.end()));
+		};
+		return count;
+	};
+
+	template <std::size_t Count, std::size_t Generators>
+	constexpr std::array<Direction, Count> Expand(std::array<Direction, Generators> const& generators)
+	{
+		std::array<Direction, Count> directions{};
+		std::size_t count{ 0 };
+		for (Direction const& generator : generators)
+		{
+			std::array<Real, 3> c = generator.point;
+			std::sort(c.begin(), c.end());
+			do
+			{
+				for (uint8_t sign{ 0 };sign < 8;++sign)
+				{
+					// Skip sign flips of zero coordinates
+					bool duplicate{ false };
+					std::array<Real, 3> p = c;
+					for (uint8_t i{ 0 };i < 3;++i)
+						if ((sign >> i) & 1)
+						{
+							duplicate |= (c[i] == 0);
+							p[i] = -p[i];
+						};
+					if (!duplicate)
+						directions[count++] = { p, generator.weight };
+				};
+			} while (std::next_permutation(c.begin(), c.end()));
+		};
+		return directions;
+	};
+
+	namespace Rule
+	{
+		constexpr Real r2 = 0.707106781186547524400844362104849039q; // 1/sqrt(2)
+		constexpr Real r3 = 0.577350269189625764509148780501957456q; // 1/sqrt(3)
+
+		// Quadrature formulas for integrals over a sphere of orders 3 to 11 (Lebedev)
+		// V. I. Lebedev
+		//
+		// Directions 6, 14, 26, 38, 50, exact for degree 3, 5, 7, 9, 11
+		constexpr std::array<Direction, 1> lebedev_6_generators{ {
+			{ { 0, 0, 1 }, Real(1) / 6 }
+		} };
+		constexpr std::array<Direction, 2> lebedev_14_generators{ {
+			{ { 0, 0, 1 }, Real(1) / 15 },
+			{ { r3, r3, r3 }, Real(3) / 40 }
+		} };
+		constexpr std::array<Direction, 3> lebedev_26_generators{ {
+			{ { 0, 0, 1 }, Real(1) / 21 },
+			{ { 0, r2, r2 }, Real(4) / 105 },
+			{ { r3, r3, r3 }, Real(9) / 280 }
+		} };
+		constexpr std::array<Direction, 3> lebedev_38_generators{ {
+			{ { 0, 0, 1 }, Real(1) / 105 },
+			{ { r3, r3, r3 }, Real(9) / 280 },
+			// sqrt((3 -+ sqrt(3))/6)
+			{ { 0, 0.459700843380983060977634009904495300q, 0.888073833977115262160764596418121804q }, Real(1) / 35 }
+		} };
+		constexpr std::array<Direction, 4> lebedev_50_generators{ {
+			{ { 0, 0, 1 }, Real(4) / 315 },
+			{ { 0, r2, r2 }, Real(64) / 2835 },
+			{ { r3, r3, r3 }, Real(27) / 1280 },
+			// 1/sqrt(11), 3/sqrt(11)
+			{ { 0.301511344577763622646812066970062426q, 0.301511344577763622646812066970062426q,
+				0.904534033733290867940436200910187277q }, Real(14641) / 725760 }
+		} };
+
+		constexpr auto lebedev_6 = Expand<Points(lebedev_6_generators)>(lebedev_6_generators);
+		constexpr auto lebedev_14 = Expand<Points(lebedev_14_generators)>(lebedev_14_generators);
+		constexpr auto lebedev_26 = Expand<Points(lebedev_26_generators)>(lebedev_26_generators);
+		constexpr auto lebedev_38 = Expand<Points(lebedev_38_generators)>(lebedev_38_generators);
+		constexpr auto lebedev_50 = Expand<Points(lebedev_50_generators)>(lebedev_50_generators);
+
+		// Spherical t-designs, equal weights.
+		// Vertices of the tetrahedron (t = 2) and the icosahedron (t = 5),
+		// the octahedron (t = 3) is lebedev_6.
+		constexpr std::array<Direction, 4> design_2{ {
+			{ { r3, r3, r3 }, Real(1) / 4 },
+			{ { r3, -r3, -r3 }, Real(1) / 4 },
+			{ { -r3, r3, -r3 }, Real(1) / 4 },
+			{ { -r3, -r3, r3 }, Real(1) / 4 }
+		} };
+
+		// (0, +-1, +-phi) and cyclic permutations, normalised
+		constexpr Real ico_a = 0.525731112119133606025669084847876607q;
+		constexpr Real ico_b = 0.850650808352039932181540497063011072q;
+		constexpr std::array<Direction, 12> design_5{ {
+			{ { 0, ico_a, ico_b }, Real(1) / 12 }, { { 0, ico_a, -ico_b }, Real(1) / 12 },
+			{ { 0, -ico_a, ico_b }, Real(1) / 12 }, { { 0, -ico_a, -ico_b }, Real(1) / 12 },
+			{ { ico_a, ico_b, 0 }, Real(1) / 12 }, { { ico_a, -ico_b, 0 }, Real(1) / 12 },
+			{ { -ico_a, ico_b, 0 }, Real(1) / 12 }, { { -ico_a, -ico_b, 0 }, Real(1) / 12 },
+			{ { ico_b, 0, ico_a }, Real(1) / 12 }, { { -ico_b, 0, ico_a }, Real(1) / 12 },
+			{ { ico_b, 0, -ico_a }, Real(1) / 12 }, { { -ico_b, 0, -ico_a }, Real(1) / 12 }
+		} };
+
+		// Lowest Lebedev rule exact for spherical polynomials of 'degree',
+		// empty if no rule is available
+		std::span<Direction const> Lebedev(uint8_t const& degree)
+		{
+			if (degree <= 3) return lebedev_6;
+			if (degree <= 5) return lebedev_14;
+			if (degree <= 7) return lebedev_26;
+			if (degree <= 9) return lebedev_38;
+			if (degree <= 11) return lebedev_50;
+			return {};
+		};
+
+		// Smallest tabulated t-design of strength at least 't'
+		std::span<Direction const> Design(uint8_t const& t)
+		{
+			if (t <= 2) return design_2;
+			if (t <= 3) return lebedev_6;
+			if (t <= 5) return design_5;
+			return {};
+		};
+	};
+
+	// Rule on the sphere as structure of arrays, for loops over the directions
+	template <typename T = Real>
+	struct Sphere
+	{
+		std::vector<T> x;
+		std::vector<T> y;
+		std::vector<T> z;
+		std::vector<T> weight;
+
+		Sphere() {};
+		Sphere(std::span<Direction const> rule)
+		{
+			for (Direction const& d : rule)
+			{
+				x.push_back(static_cast<T>(d.point[0]));
+				y.push_back(static_cast<T>(d.point[1]));
+				z.push_back(static_cast<T>(d.point[2]));
+				weight.push_back(static_cast<T>(d.weight));
+			};
+		};
+
+		std::size_t Size() const { return weight.size(); };
+	};
+
+	// Larger rules from a file, as published tables are too long to keep here.
+	// Layout: "SPHERE01", uint64_t count, then count doubles each of x, y, z and weight.
+	// Returns an empty rule if the file can not be read, or holds no points.
+	template <typename T = Real>
+	Sphere<T> LoadSphere(char const* path)
+	{
+		Sphere<T> sphere;
+
+		int const file = ::open(path, O_RDONLY);
+		if (file < 0)
+			return sphere;
+
+		struct stat status;
+		if ((::fstat(file, &status) != 0) || (status.st_size < 16))
+		{
+			::close(file);
+			return sphere;
+		}
+
+		std::size_t const size = static_cast<std::size_t>(status.st_size);
+		void* const map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+		if (map == MAP_FAILED)
+			return sphere;
+
+		char const* data = static_cast<char const*>(map);
+		uint64_t count{ 0 };
+		std::memcpy(&count, data + 8, sizeof(count));
+		// Count from the file, compared by division as the product may wrap around (size is at least 16)
+		if ((std::memcmp(data, "SPHERE01", 8) == 0) && count && (count <= (size - 16) / (4 * sizeof(double))))
+		{
+			double const* column = reinterpret_cast<double const*>(data + 16);
+			for (std::vector<T>* target : { &sphere.x, &sphere.y, &sphere.z, &sphere.weight })
+			{
+				target->assign(column, column + count);
+				column += count;
+			};
+		};
+
+		::munmap(map, size);
+		return sphere;
+	};
+
+	namespace Detail
+	{
+		// Weighted sum in independent lanes, which the compiler can keep in vector registers
+		template <typename T>
+		T Dot(
+			std::span<T const> weight,
+			std::span<T const> value)
+		{
+			constexpr std::size_t lanes{ 8 };
+			std::array<T, lanes> sum{};
+			std::size_t const n = weight.size();
+			std::size_t i{ 0 };
+			for (;i + lanes <= n;i += lanes)
+				for (std::size_t l{ 0 };l < lanes;++l)
+					sum[l] += weight[i + l] * value[i + l];
+			for (;i < n;++i)
+				sum[0] += weight[i] * value[i];
+
+			T total{ 0 };
+			for (T const& s : sum)
+				total += s;
+			return total;
+		};
+	};
+
+	// Integrals over the sphere of 'integrals.size()' functions, from one call of the integrand.
+	// It fills the value of function f at direction i into values[f * directions + i]:
+	//   void integrand(std::span<T const> x, std::span<T const> y, std::span<T const> z, std::span<T> values)
+	template <typename T, typename Integrand>
+	void Integrate(
+		Integrand const& integrand,
+		Sphere<T> const& sphere,
+		std::span<T> integrals)
+	{
+		std::size_t const n = sphere.Size();
+		std::vector<T> values(n * integrals.size());
+		integrand(std::span<T const>(sphere.x), std::span<T const>(sphere.y), std::span<T const>(sphere.z),
+			std::span<T>(values));
+
+		for (std::size_t f{ 0 };f < integrals.size();++f)
+			integrals[f] = 4 * static_cast<T>(pi) *
+			Detail::Dot<T>(sphere.weight, std::span<T const>(values).subspan(f * n, n));
+	};
+
+	// Integrals of one function rotated, f(R d), for each rotation R
+	// (3x3, row major, nine values per rotation in 'rotations').
+	// All integrals are NaN if the rotations are fewer than the integrals.
+	// The integrand fills one value per direction:
+	//   void integrand(std::span<T const> x, std::span<T const> y, std::span<T const> z, std::span<T> values)
+	template <typename T, typename Integrand>
+	void IntegrateRotated(
+		Integrand const& integrand,
+		Sphere<T> const& sphere,
+		std::span<T const> rotations,
+		std::span<T> integrals)
+	{
+		if (rotations.size() / 9 < integrals.size())
+		{
+			std::fill(integrals.begin(), integrals.end(), static_cast<T>(NaN));
+			return;
+		}
+
+		std::size_t const n = sphere.Size();
+		std::vector<T> x(n), y(n), z(n), values(n);
+
+		for (std::size_t r{ 0 };r < integrals.size();++r)
+		{
+			T const* R = rotations.data() + 9 * r;
+			for (std::size_t i{ 0 };i < n;++i)
+			{
+				x[i] = R[0] * sphere.x[i] + R[1] * sphere.y[i] + R[2] * sphere.z[i];
+				y[i] = R[3] * sphere.x[i] + R[4] * sphere.y[i] + R[5] * sphere.z[i];
+				z[i] = R[6] * sphere.x[i] + R[7] * sphere.y[i] + R[8] * sphere.z[i];
+			};
+			integrand(std::span<T const>(x), std::span<T const>(y), std::span<T const>(z), std::span<T>(values));
+			integrals[r] = 4 * static_cast<T>(pi) * Detail::Dot<T>(sphere.weight, values);
+		};
+	};
+
+};
@@ -0,0 +1,243 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "./quadrature.hpp"
+#include "./pool.hpp"
+
+// Integrals I(p) of f(x, p) from 'a' to 'b', for an ordered grid of parameters p
+namespace Quadrature
+{
+	// Lobatto rule (as LobattoResult) for each parameter.
+	// The grid is split in contiguous chunks, one per thread of the pool (f is called from several threads),
+	// and each integral starts from the mesh its neighbour converged on.
+	//
+	// The mesh is the tree of split intervals, its abscissae are known before the integrand is called,
+	// so they are evaluated in one flat pass. Intervals are refined where the new parameter needs it,
+	// and merged where the neighbour's split was not needed. While neighbours converge
+	// on identical meshes, the abscissae are reused as they are.
+	//
+	// The intervals accepted are those of LobattoResult, and their areas and errors are summed
+	// in the same order: value, error and status are those of LobattoResult bit for bit, whatever the threads.
+	// Evaluations count the calls of the integrand, which include the abscissae of splits
+	// of the neighbour's mesh that turn out not to be needed.
+	template <typename Function, typename Value = Accumulated<std::invoke_result_t<Function const&, Real, Real>>>
+		requires std::invocable<Function const&, Real, Real>
+	std::vector<Result<Value>> Sweep(
+		Function const& function,
+		Real a,
+		Real b,
+		std::span<Real const> parameters,
+		Real const& a_epsilon = 1e-10,
+		uint8_t const& a_max_depth = 2,
+		unsigned const a_threads = std::thread::hardware_concurrency())
+	{
+		Real static const node_lobatto = std::sqrt(Real(1) / Real(5));
+		Real static const node_kronrod = std::sqrt(Real(2) / Real(3));
+
+		if (b < a)
+			std::swap(a, b);
+
+		uint8_t const max_depth = std::min(a_max_depth, static_cast<uint8_t>(8));
+		unsigned const threads = std::max(a_threads, 1u);
+
+		Real const epsilon = std::max(a_epsilon, numeric_epsilon);
+
+		std::vector<Result<Value>> results(parameters.size());
+
+		// Interval ends, with the Lobatto and Kronrod points between
+		auto abscissae = [](Real const& start, Real const& end) -> std::array<Real, 7>
+		{
+			Real const h = (end - start) / 2;
+			Real const middle = (start + end) / 2;
+			return { start,
+				middle - node_kronrod * h, middle - node_lobatto * h, middle,
+				middle + node_lobatto * h, middle + node_kronrod * h, end };
+		};
+
+		struct Data
+		{
+			Real x{ 0 };
+			Value y{ 0 }; // f(x)
+		};
+
+		// Accepted interval
+		struct Leaf
+		{
+			Real error{ 0 };
+			bool limit{ false };
+		};
+
+		auto chunk = [&](std::size_t const first, std::size_t const last)
+		{
+			// Preorder, true if an interval was split in six, a single interval to begin with
+			std::vector<bool> mesh{ false };
+			std::vector<bool> next;
+			std::vector<Leaf> leaves; // Depth first
+
+			// Abscissae of the mesh, in the order the walk below uses them
+			std::vector<Real> pattern;
+			std::vector<Value> values;
+			bool rebuild = true;
+
+			for (std::size_t k{ first };k < last;++k)
+			{
+				Real const parameter = parameters[k];
+				Result<Value>& result = results[k];
+
+				if (rebuild)
+				{
+					pattern.assign({ a, b });
+					std::size_t index{ 0 };
+					auto build = [&](
+						// Self reference, needed for recursion, C++23
+						this auto const& meta,
+						Real const& start,
+						Real const& end) -> void
+					{
+						std::array<Real, 7> const x = abscissae(start, end);
+						pattern.insert(pattern.end(), x.begin() + 1, x.begin() + 6);
+						if (mesh[index++])
+							for (std::size_t i{ 0 };i < 6;++i)
+								meta(x[i], x[i + 1]);
+					};
+					build(a, b);
+				}
+
+				values.resize(pattern.size());
+				for (std::size_t i{ 0 };i < pattern.size();++i)
+					values[i] = function(pattern[i], parameter);
+				result.evaluations = pattern.size();
+
+				std::size_t index{ 0 };
+				std::size_t cursor{ 2 };
+				next.clear();
+				leaves.clear();
+
+				// Passes over a split of the previous mesh which is not needed
+				auto skip = [&](
+					// Self reference, needed for recursion, C++23
+					this auto const& meta) -> void
+				{
+					cursor += 5;
+					if (mesh[index++])
+						for (std::size_t i{ 0 };i < 6;++i)
+							meta();
+				};
+
+				// Intervals of the previous mesh take their values from the pattern,
+				// new intervals call the integrand
+				auto walk = [&](
+					// Self reference, needed for recursion, C++23
+					this auto const& meta,
+					Data const& start,
+					Data const& end,
+					uint8_t const depth,
+					bool const recorded) -> Value
+				{
+					std::array<Real, 7> const x = abscissae(start.x, end.x);
+					bool const split = recorded && mesh[index++];
+
+					std::array<Value, 7> y;
+					y[0] = start.y;
+					y[6] = end.y;
+					for (std::size_t i{ 1 };i < 6;++i)
+						y[i] = recorded ? values[cursor++] : function(x[i], parameter);
+					if (!recorded)
+						result.evaluations += 5;
+
+					Real const h = (end.x - start.x) / 2;
+
+					// Seven point area approximation
+					Value const area_kronrod = (h / 1470) *
+						((y[0] + y[6]) * Real(77) + (y[1] + y[5]) * Real(432) + (y[2] + y[4]) * Real(625) + y[3] * Real(672));
+
+					if (!IsFinite(area_kronrod))
+						return Value(NaN);
+
+					// Four point area approximation
+					Value const area_lobatto = (h / 6) * (y[0] + y[6] + (y[2] + y[4]) * Real(5));
+
+					// Error estimate
+					Real const error = Magnitude(area_kronrod - area_lobatto);
+
+					bool const limit = (std::abs(h) < numeric_interval) || (depth + 1 > max_depth);
+					if (limit || (error < epsilon))
+					{
+						// Merged, if this parameter did not need the split
+						if (split)
+							for (std::size_t i{ 0 };i < 6;++i)
+								skip();
+						leaves.push_back({ error, limit && (error >= epsilon) });
+						next.push_back(false);
+						return area_kronrod;
+					}
+
+					next.push_back(true);
+
+					// Summed from the left, as LobattoResult
+					Value area = meta(Data{ x[0], y[0] }, Data{ x[1], y[1] }, depth + 1, split);
+					for (std::size_t i{ 1 };i < 6;++i)
+						area += meta(Data{ x[i], y[i] }, Data{ x[i + 1], y[i + 1] }, depth + 1, split);
+					return area;
+				};
+
+				result.value = walk(Data{ a, values[0] }, Data{ b, values[1] }, 0, true);
+				for (Leaf const& leaf : leaves)
+				{
+					result.error += leaf.error;
+					if (leaf.limit)
+						result.status = Status::limit;
+				};
+
+				if (!IsFinite(result.value))
+				{
+					result.value = Value(NaN);
+					result.status = Status::not_finite;
+					mesh.assign({ false });
+					rebuild = true;
+					continue;
+				}
+
+				rebuild = (next != mesh);
+				std::swap(mesh, next);
+			};
+		};
+
+		std::size_t const n = parameters.size();
+		std::size_t const chunks = std::min<std::size_t>(threads, n);
+		WorkIndices indices(chunks, chunks);
+		ThreadPool::Instance().Run(chunks, [&]()
+			{
+				for (std::size_t t = indices.Next();t < chunks;t = indices.Next())
+					chunk(t * n / chunks, (t + 1) * n / chunks);
+			});
+
+		return results;
+	};
+
+};
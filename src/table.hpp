@@ -0,0 +1,437 @@
+// Copyright (c) 2024 Thomas Klietsch, all rights reserved.
+//
+// Licensed under the GNU Lesser General Public License, version 3.0 or later
+//
+// This program is free software: you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of
+// the License, or ( at your option ) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General
+// Public License along with this program.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./quadrature.hpp"
+#include "./plugin.h"
+
+// Tables of results (parameters, value, error, evaluations, status) in a binary file,
+// host byte order, which is read back by mapping it into memory.
+//
+//	Header, 64 bytes, then blocks of rows, each
+//	uint64 rows, uint64 bytes of the block, then the columns:
+//	every parameter, value and error (elements), evaluations (uint64), status (uint8)
+//
+// Elements are stored bit for bit, as binary64, double-double, x87 extended or binary128.
+// Every column starts on 16 bytes, so the reader hands out columns in place.
+namespace Quadrature::Table
+{
+	constexpr uint32_t version{ 1 };
+
+	enum class Encoding : uint8_t
+	{
+		binary64 = 1,
+		double_double = 2,
+		extended = 3, // x87 80 bit, in 16 bytes
+		binary128 = 4
+	};
+
+	struct Header
+	{
+		char magic[8]{ 'Q', 'U', 'A', 'D', 'T', 'A', 'B', '\0' };
+		uint32_t version{ Table::version };
+		uint32_t byte_order{ 0x01020304 };
+		Encoding encoding{ Encoding::binary64 };
+		uint8_t element_size{ 0 };
+		uint16_t reserved{ 0 };
+		uint32_t parameters{ 0 }; // Parameter columns
+		uint64_t rows{ 0 };
+		uint64_t blocks{ 0 };
+		uint8_t padding[24]{};
+	};
+	static_assert(sizeof(Header) == 64);
+
+	namespace Detail
+	{
+		constexpr std::size_t alignment{ 16 };
+		constexpr std::size_t block_header{ 2 * sizeof(uint64_t) };
+
+		constexpr std::size_t Pad(std::size_t const bytes)
+		{
+			return (bytes + alignment - 1) / alignment * alignment;
+		};
+
+		template <typename Element>
+		constexpr Encoding EncodingOf()
+		{
+			if constexpr (std::is_same_v<Element, quadrature_dd>)
+				return Encoding::double_double;
+			else
+			{
+				static_assert(std::numeric_limits<Element>::is_iec559, "Elements are IEEE 754 numbers or double-double");
+				constexpr int digits = std::numeric_limits<Element>::digits;
+				static_assert((digits == 53) || (digits == 64) || (digits == 113), "No encoding of this floating point type");
+				if constexpr (digits == 53)
+					return Encoding::binary64;
+				else if constexpr (digits == 64)
+					return Encoding::extended;
+				else
+					return Encoding::binary128;
+			}
+		};
+
+		template <typename Element>
+		Element Store(Real const& x)
+		{
+			if constexpr (std::is_same_v<Element, quadrature_dd>)
+			{
+				double const hi = static_cast<double>(x);
+				return { hi, static_cast<double>(x - Real(hi)) };
+			}
+			else
+				return static_cast<Element>(x);
+		};
+
+		// Bytes of a block of 'rows'
+		template <typename Element>
+		constexpr std::size_t BlockSize(
+			std::size_t const rows,
+			std::size_t const parameters)
+		{
+			return block_header + (parameters + 2) * Pad(rows * sizeof(Element))
+				+ Pad(rows * sizeof(uint64_t)) + Pad(rows * sizeof(uint8_t));
+		};
+	};
+
+	// Appends rows to a new file, in blocks of 'block_rows'.
+	// The header is rewritten after each block, the file is readable while it grows.
+	template <typename Element = Real>
+	class Writer
+	{
+	public:
+		Writer(
+			std::string const& path,
+			uint32_t const parameters = 0,
+			std::size_t const block_rows = 1 << 16)
+			: file(path, std::ios::binary | std::ios::trunc)
+			, block_rows(std::max<std::size_t>(block_rows, 1))
+			, columns(parameters)
+		{
+			header.encoding = Detail::EncodingOf<Element>();
+			header.element_size = sizeof(Element);
+			header.parameters = parameters;
+			WriteHeader();
+		};
+
+		Writer(Writer const&) = delete;
+		Writer& operator=(Writer const&) = delete;
+
+		~Writer()
+		{
+			Flush();
+		};
+
+		// False if the file could not be written, or rows were of the wrong size
+		bool Valid() const
+		{
+			return valid && file.good();
+		};
+
+		// Results with their parameters, row after row
+		void Append(
+			std::span<Real const> const parameters,
+			std::span<Result<Real> const> const results)
+		{
+			if (parameters.size() != results.size() * header.parameters)
+			{
+				valid = false;
+				return;
+			}
+			for (std::size_t row{ 0 };row < results.size();++row)
+			{
+				for (uint32_t j{ 0 };j < header.parameters;++j)
+					columns[j].push_back(Detail::Store<Element>(parameters[row * header.parameters + j]));
+				values.push_back(Detail::Store<Element>(results[row].value));
+				errors.push_back(Detail::Store<Element>(results[row].error));
+				evaluations.push_back(results[row].evaluations);
+				status.push_back(static_cast<uint8_t>(results[row].status));
+				if (values.size() == block_rows)
+					Flush();
+			};
+		};
+
+		// Columns as stored, parameters column after column
+		void Append(
+			std::span<Element const> const parameters,
+			std::span<Element const> const values,
+			std::span<Element const> const errors,
+			std::span<uint64_t const> const evaluations,
+			std::span<Status const> const status)
+		{
+			std::size_t const rows = values.size();
+			if ((parameters.size() != rows * header.parameters) || (errors.size() != rows)
+				|| (evaluations.size() != rows) || (status.size() != rows))
+			{
+				valid = false;
+				return;
+			}
+			for (std::size_t first{ 0 };first < rows;)
+			{
+				std::size_t const size = std::min(rows - first, block_rows - this->values.size());
+				for (uint32_t j{ 0 };j < header.parameters;++j)
+				{
+					auto const column = parameters.subspan(j * rows + first, size);
+					columns[j].insert(columns[j].end(), column.begin(), column.end());
+				};
+				this->values.insert(this->values.end(), values.begin() + first, values.begin() + first + size);
+				this->errors.insert(this->errors.end(), errors.begin() + first, errors.begin() + first + size);
+				this->evaluations.insert(this->evaluations.end(), evaluations.begin() + first, evaluations.begin() + first + size);
+				for (std::size_t i{ first };i < first + size;++i)
+					this->status.push_back(static_cast<uint8_t>(status[i]));
+				first += size;
+				if (this->values.size() == block_rows)
+					Flush();
+			};
+		};
+
+		// Writes the rows appended so far as a block
+		void Flush()
+		{
+			std::size_t const rows = values.size();
+			if (!rows)
+				return;
+
+			if (file)
+			{
+				uint64_t const block[2]{ rows, Detail::BlockSize<Element>(rows, header.parameters) };
+				file.write(reinterpret_cast<char const*>(block), sizeof(block));
+				for (auto const& column : columns)
+					Write(column);
+				Write(values);
+				Write(errors);
+				Write(evaluations);
+				Write(status);
+
+				header.rows += rows;
+				++header.blocks;
+				WriteHeader();
+			}
+
+			for (auto& column : columns)
+				column.clear();
+			values.clear();
+			errors.clear();
+			evaluations.clear();
+			status.clear();
+		};
+
+	private:
+		template <typename T>
+		void Write(std::vector<T> const& column)
+		{
+			static constexpr char zero[Detail::alignment]{};
+			std::size_t const bytes = column.size() * sizeof(T);
+			file.write(reinterpret_cast<char const*>(column.data()), bytes);
+			file.write(zero, Detail::Pad(bytes) - bytes);
+		};
+
+		void WriteHeader()
+		{
+			std::streampos const end = file.tellp();
+			file.seekp(0);
+			file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+			if (end > std::streampos(sizeof(header)))
+				file.seekp(end);
+			file.flush();
+		};
+
+		std::ofstream file;
+		std::size_t const block_rows;
+		Header header;
+		bool valid{ true };
+
+		std::vector<std::vector<Element>> columns;
+		std::vector<Element> values;
+		std::vector<Element> errors;
+		std::vector<uint64_t> evaluations;
+		std::vector<uint8_t> status;
+	};
+
+	// Maps a file of Writer<Element>, columns are read in place
+	template <typename Element = Real>
+	class Reader
+	{
+	public:
+		// Rows of one block
+		class Block
+		{
+		public:
+			std::size_t Rows() const
+			{
+				return rows;
+			};
+
+			std::span<Element const> Parameters(std::size_t const j) const
+			{
+				return Column<Element>(j * Detail::Pad(rows * sizeof(Element)));
+			};
+
+			std::span<Element const> Values() const
+			{
+				return Column<Element>(parameters * Detail::Pad(rows * sizeof(Element)));
+			};
+
+			std::span<Element const> Errors() const
+			{
+				return Column<Element>((parameters + 1) * Detail::Pad(rows * sizeof(Element)));
+			};
+
+			std::span<uint64_t const> Evaluations() const
+			{
+				return Column<uint64_t>((parameters + 2) * Detail::Pad(rows * sizeof(Element)));
+			};
+
+			std::span<Status const> Statuses() const
+			{
+				return Column<Status>((parameters + 2) * Detail::Pad(rows * sizeof(Element)) + Detail::Pad(rows * sizeof(uint64_t)));
+			};
+
+		private:
+			friend class Reader;
+
+			Block(
+				char const* const data,
+				std::size_t const rows,
+				std::size_t const parameters)
+				: data(data)
+				, rows(rows)
+				, parameters(parameters)
+			{};
+
+			// Offset past the last column, that of the statuses
+			std::size_t End() const
+			{
+				return (parameters + 2) * Detail::Pad(rows * sizeof(Element)) + Detail::Pad(rows * sizeof(uint64_t)) + rows * sizeof(Status);
+			};
+
+			template <typename T>
+			std::span<T const> Column(std::size_t const offset) const
+			{
+				return { reinterpret_cast<T const*>(data + offset), rows };
+			};
+
+			char const* data; // First column
+			std::size_t rows;
+			std::size_t parameters;
+		};
+
+		explicit Reader(std::string const& path)
+		{
+			int const descriptor = open(path.c_str(), O_RDONLY);
+			if (descriptor < 0)
+				return;
+			struct stat status;
+			if ((fstat(descriptor, &status) == 0) && (status.st_size >= static_cast<off_t>(sizeof(Header))))
+			{
+				size = status.st_size;
+				void* const mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+				data = (mapped == MAP_FAILED) ? nullptr : static_cast<char const*>(mapped);
+			}
+			close(descriptor);
+			if (data)
+				valid = Index();
+		};
+
+		Reader(Reader const&) = delete;
+		Reader& operator=(Reader const&) = delete;
+
+		~Reader()
+		{
+			if (data)
+				munmap(const_cast<char*>(data), size);
+		};
+
+		// False if the file could not be mapped, or is not a table of Element
+		bool Valid() const
+		{
+			return valid;
+		};
+
+		Header const& Info() const
+		{
+			return header;
+		};
+
+		std::size_t Rows() const
+		{
+			return header.rows;
+		};
+
+		std::span<Block const> Blocks() const
+		{
+			return blocks;
+		};
+
+	private:
+		bool Index()
+		{
+			std::memcpy(&header, data, sizeof(header));
+			if ((std::memcmp(header.magic, Header{}.magic, sizeof(header.magic)) != 0)
+				|| (header.version != version) || (header.byte_order != Header{}.byte_order)
+				|| (header.encoding != Detail::EncodingOf<Element>()) || (header.element_size != sizeof(Element)))
+				return false;
+
+			std::size_t position{ sizeof(Header) };
+			uint64_t rows{ 0 };
+			for (uint64_t b{ 0 };b < header.blocks;++b)
+			{
+				uint64_t block[2]{ 0, 0 };
+				if (size - position < sizeof(block))
+					return false;
+				std::memcpy(block, data + position, sizeof(block));
+				if (block[0] > size)
+					return false;
+				// The parameter count is read from the file, its columns must fit before they are multiplied out
+				std::size_t const column = Detail::Pad(block[0] * sizeof(Element));
+				if (column && (header.parameters + std::size_t{ 2 } > (size - position) / column))
+					return false;
+				if ((block[1] != Detail::BlockSize<Element>(block[0], header.parameters)) || (size - position < block[1]))
+					return false;
+				Block const next(data + position + Detail::block_header, block[0], header.parameters);
+				if (Detail::block_header + next.End() > block[1])
+					return false;
+				blocks.push_back(next);
+				rows += block[0];
+				position += block[1];
+			};
+			return rows == header.rows;
+		};
+
+		char const* data{ nullptr };
+		std::size_t size{ 0 };
+		bool valid{ false };
+		Header header;
+		std::vector<Block> blocks;
+	};
+
+};